@@ -0,0 +1,154 @@
+/*
+ * FlashArray: random access persistent array of fixed size elements stored in a SPIFlashA memory.
+ * Elements are read through a small RAM cache of LINES lines of LINESIZE bytes (by default 2 lines of one 256 bytes page)
+ * with a Least Recently Used replacement, so that access patterns with locality (table scans, interpolation between
+ * neighbour points, binary searches near the end) are served from RAM instead of one FAST_READ transaction per element.
+ *
+ * Usage:
+ *		FlashArray<int> curve(flash, 0x10000, 1024);		// 1024 int starting at address 0x10000
+ *		int y = curve[512];
+ *		for (FlashArray<int>::iterator it = curve.begin(); it != curve.end(); ++it) sum += *it;
+ *
+ * NOTES:
+ *		1. The memory occupied by the array must be erased before put() is used (see the SPIFlashA WARNING on writes)
+ *		2. LINESIZE should be a power of 2 dividing 256 so that a cache line never spans two flash pages
+ *		3. Cache statistics are kept as hits() and misses(), resetStats() clears them
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _FLASHARRAY_H_
+#define _FLASHARRAY_H_
+
+#include <SPIFlashA.h>
+
+template <typename T, byte LINES = 2, word LINESIZE = 256>
+class FlashArray {
+public:
+  /// Random access iterator over the array elements (read only)
+  class iterator {
+  public:
+    iterator(FlashArray* array, long index) : _array(array), _index(index) {}
+    T operator*() const { return (*_array)[_index]; }
+    T operator[](long n) const { return (*_array)[_index + n]; }
+    iterator& operator++() { ++_index; return *this; }
+    iterator& operator--() { --_index; return *this; }
+    iterator operator++(int) { iterator old = *this; ++_index; return old; }
+    iterator operator--(int) { iterator old = *this; --_index; return old; }
+    iterator& operator+=(long n) { _index += n; return *this; }
+    iterator& operator-=(long n) { _index -= n; return *this; }
+    iterator operator+(long n) const { return iterator(_array, _index + n); }
+    iterator operator-(long n) const { return iterator(_array, _index - n); }
+    long operator-(const iterator& other) const { return _index - other._index; }
+    boolean operator==(const iterator& other) const { return _index == other._index; }
+    boolean operator!=(const iterator& other) const { return _index != other._index; }
+    boolean operator<(const iterator& other) const { return _index < other._index; }
+    boolean operator>(const iterator& other) const { return _index > other._index; }
+    boolean operator<=(const iterator& other) const { return _index <= other._index; }
+    boolean operator>=(const iterator& other) const { return _index >= other._index; }
+    long index() const { return _index; }
+  private:
+    FlashArray* _array;
+    long _index;
+  };
+
+  FlashArray(SPIFlashA& flash, long base, long count) : _flash(flash), _base(base), _count(count) {
+    invalidate();
+    resetStats();
+  }
+
+  long size() const { return _count; }
+  long address(long i) const { return _base + i * (long) sizeof(T); }
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, _count); }
+
+  /// return element i, through the cache
+  T operator[](long i) {
+    T value;
+    get(i, value);
+    return value;
+  }
+
+  /// copy element i into value, an element may span two cache lines
+  void get(long i, T& value) {
+    long addr = address(i);
+    byte* dst = (byte*) &value;
+    word len = sizeof(T);
+    while (len > 0) {
+      long tag = addr & ~(long)(LINESIZE - 1);
+      word offset = addr - tag;
+      word n = LINESIZE - offset;
+      if (n > len) n = len;
+      memcpy(dst, _data[lookup(tag)] + offset, n);
+      dst += n;
+      addr += n;
+      len -= n;
+    }
+  }
+
+  /// write element i to flash (the location must be erased) and update any cached copy
+  void put(long i, const T& value) {
+    long addr = address(i);
+    const byte* src = (const byte*) &value;
+    word len = sizeof(T);
+    while (len > 0) {
+      word n = 256 - (addr & 255);		// Page Program cannot cross a page boundary
+      if (n > len) n = len;
+      _flash.writeBytes(addr, src, n);
+      for (byte l = 0; l < LINES; l++)		// Keep the cached lines coherent with what the chip now holds (1->0 only)
+        for (word k = 0; k < n; k++)
+          if (_tag[l] == ((addr + k) & ~(long)(LINESIZE - 1)))
+            _data[l][(addr + k) & (LINESIZE - 1)] &= src[k];
+      src += n;
+      addr += n;
+      len -= n;
+    }
+  }
+
+  /// drop all cached lines (to be used when the flash was changed behind the array, e.g. after an erase)
+  void invalidate() {
+    for (byte l = 0; l < LINES; l++) {
+      _tag[l] = -1;
+      _age[l] = 0;
+    }
+    _clock = 0;
+  }
+
+  unsigned long hits() const { return _hits; }
+  unsigned long misses() const { return _misses; }
+  void resetStats() { _hits = 0; _misses = 0; }
+
+private:
+  /// return the line holding tag, loading it in place of the least recently used one on a miss
+  byte lookup(long tag) {
+    byte victim = 0;
+    for (byte l = 0; l < LINES; l++) {
+      if (_tag[l] == tag) {
+        _hits++;
+        _age[l] = ++_clock;
+        return l;
+      }
+      if (_tag[l] == -1 || (_tag[victim] != -1 && _age[l] < _age[victim]))
+        victim = l;
+    }
+    _misses++;
+    _flash.readBytes(tag, _data[victim], LINESIZE);
+    _tag[victim] = tag;
+    _age[victim] = ++_clock;
+    return victim;
+  }
+
+  SPIFlashA& _flash;
+  long _base;
+  long _count;
+  long _tag[LINES];						// Flash address of each cached line, -1 when empty
+  unsigned long _age[LINES];				// Last use of each line, smallest is the LRU victim
+  unsigned long _clock;
+  unsigned long _hits;
+  unsigned long _misses;
+  byte _data[LINES][LINESIZE];
+};
+
+#endif
@@ -39,29 +39,71 @@ byte SPIFlashA::UNIQUEID[12];
 SPIFlashA::SPIFlashA(uint8_t slaveSelectPin, uint32_t jedecID) {
   _slaveSelectPin = slaveSelectPin;
   _jedecID = jedecID;
+  _eraseListener = 0;
+  _eraseSize = 0;
+  _erasedTo = _eraseNext = _eraseEnd = 0;
+  _eraseSuspend = _suspended = false;
+  _resumeTime = 0;
+#ifdef SPIFLASHA_TRANSPORT
+  _transport = 0;
+#endif
+  SPIFLASHA_STAT(resetStats());
+  SPIFLASHA_HISTO(resetHistograms());
+  SPIFLASHA_TRACED(clearTrace());
 }
 
 /// Select the flash chip
 void SPIFlashA::select() {
-  noInterrupts();
-  //save current SPI settings
-  _SPCR = SPCR;					// Required if Multiple SPI are used (typically RFM69)
-  _SPSR = SPSR;
-  //set FLASH chip SPI settings
-  SPI.setDataMode(SPI_MODE0);
-  SPI.setBitOrder(MSBFIRST);
-  SPI.setClockDivider(SPI_CLOCK_DIV4); //decided to slow down from DIV2 after SPI stalling in some instances, especially visible on mega1284p when RFM69 and FLASH chip both present
-  SPI.begin();
-  digitalWrite(_slaveSelectPin, LOW);
+#ifdef SPIFLASHA_TRANSPORT
+  if (_transport)
+    _transport->select();
+  else
+#endif
+  {
+    noInterrupts();
+    //save current SPI settings
+    _SPCR = SPCR;					// Required if Multiple SPI are used (typically RFM69)
+    _SPSR = SPSR;
+    //set FLASH chip SPI settings
+    SPI.setDataMode(SPI_MODE0);
+    SPI.setBitOrder(MSBFIRST);
+    SPI.setClockDivider(SPI_CLOCK_DIV4); //decided to slow down from DIV2 after SPI stalling in some instances, especially visible on mega1284p when RFM69 and FLASH chip both present
+    SPI.begin();
+    digitalWrite(_slaveSelectPin, LOW);
+  }
+  SPIFLASHA_STAT(_stats.selects++; _statsSelected = true; _statsSelectTime = micros());
 }
 
 /// UNselect the flash chip
 void SPIFlashA::unselect() {
-  digitalWrite(_slaveSelectPin, HIGH);
-  //restore SPI settings to what they were before talking to the FLASH chip
-  SPCR = _SPCR;				// Required if Multiple SPI are used (typically RFM69)
-  SPSR = _SPSR;
-  interrupts();
+  SPIFLASHA_TRACED(if (_traceOpen) { _trace[_traceCurrent].end = micros(); _traceOpen = false; });
+#ifdef SPIFLASHA_STATS
+  if (_statsSelected) {
+    unsigned long duration = micros() - _statsSelectTime;
+    _statsSelected = false;
+    _stats.irqOffTotal += duration;
+    if (duration > _stats.irqOffMax) _stats.irqOffMax = duration;
+  }
+#endif
+#ifdef SPIFLASHA_TRANSPORT
+  if (_transport)
+    _transport->unselect();
+  else
+#endif
+  {
+    digitalWrite(_slaveSelectPin, HIGH);
+    //restore SPI settings to what they were before talking to the FLASH chip
+    SPCR = _SPCR;				// Required if Multiple SPI are used (typically RFM69)
+    SPSR = _SPSR;
+    interrupts();
+  }
+  if (_suspended) {				// End of a read done during an erase suspend
+    _suspended = false;
+    select();
+    send(SPIFLASH_ERASERESUME);
+    unselect();
+    _resumeTime = micros();
+  }
 }
 
 /// setup SPI, read device ID etc...
@@ -76,8 +118,9 @@ boolean SPIFlashA::initialize()
   
   if (_jedecID == 0 || readDeviceId() == _jedecID) {
     command(SPIFLASH_STATUSWRITE, true); // Write Status Register
-    SPI.transfer(0);                     // Global Unprotect
+    transfer(0);                     // Global Unprotect
     unselect();
+    SPIFLASHA_STAT(_statsOp = SPIFLASHSTATS_WRITESTATUS);
     return true;
   }
   return false;
@@ -91,11 +134,12 @@ long SPIFlashA::readDeviceId()
   command(SPIFLASH_IDREAD); // Read JEDEC ID
 #else
   select();
-  SPI.transfer(SPIFLASH_IDREAD);
+  transfer(SPIFLASH_IDREAD);
+  SPIFLASHA_STAT(_stats.commands[opcodeIndex(SPIFLASH_IDREAD)]++);
 #endif
-  jedecid |= (long) SPI.transfer(0) <<16;
-  jedecid |= (long) SPI.transfer(0) << 8;
-  jedecid |= (long) SPI.transfer(0);
+  jedecid |= (long) transfer(0) <<16;
+  jedecid |= (long) transfer(0) << 8;
+  jedecid |= (long) transfer(0);
   unselect();
   return jedecid;
 }
@@ -109,37 +153,145 @@ long SPIFlashA::readDeviceId()
 byte* SPIFlashA::readUniqueId()
 {
   command(SPIFLASH_MACREAD);
-  SPI.transfer(0);
-  SPI.transfer(0);
-  SPI.transfer(0);
-  SPI.transfer(0);
+  transfer(0);
+  transfer(0);
+  transfer(0);
+  transfer(0);
   for (byte i=0;i<12;i++)				// Change from 8 to 12 for SPANSION
-    UNIQUEID[i] = SPI.transfer(0);
+    UNIQUEID[i] = transfer(0);
   unselect();
   return UNIQUEID;
 }
 
+/// send len bytes whose results are ignored
+void SPIFlashA::send(const byte* buf, word len) {
+#ifdef SPIFLASHA_TRANSPORT
+  if (_transport) {
+    SPIFLASHA_STAT(_stats.busBytes += len);
+    _transport->send(buf, len);
+    return;
+  }
+#endif
+  for (word i = 0; i < len; i++)
+    transfer(buf[i]);
+}
+
+/// receive len bytes (sending 0), with a transport they may only be in buf after the next transfer(), flush() or
+/// unselect()
+void SPIFlashA::receive(byte* buf, word len) {
+#ifdef SPIFLASHA_TRANSPORT
+  if (_transport) {
+    SPIFLASHA_STAT(_stats.busBytes += len);
+    _transport->receive(buf, len);
+    return;
+  }
+#endif
+  for (word i = 0; i < len; i++)
+    buf[i] = transfer(0);
+}
+
 /// read 1 byte from flash memory
 byte SPIFlashA::readByte(long addr) {
-  command(SPIFLASH_ARRAYREADLOWFREQ);
-  SPI.transfer(addr >> 16);
-  SPI.transfer(addr >> 8);
-  SPI.transfer(addr);
-  byte result = SPI.transfer(0);
+  readCommand(SPIFLASH_ARRAYREADLOWFREQ, addr, 1);
+  SPIFLASHA_TRACED(traceAddress(addr, 1));
+  sendAddress(addr);
+  byte result = transfer(0);
   unselect();
+  SPIFLASHA_STAT(_stats.bytesRead++);
   return result;
 }
 
 /// read unlimited # of bytes
 void SPIFlashA::readBytes(long addr, void* buf, word len) {
-  command(SPIFLASH_ARRAYREAD);
-  SPI.transfer(addr >> 16);
-  SPI.transfer(addr >> 8);
-  SPI.transfer(addr);
-  SPI.transfer(0); //"dont care"
-  for (word i = 0; i < len; ++i)
-    ((byte*) buf)[i] = SPI.transfer(0);
+  SPIFLASHA_HISTO(unsigned long start = micros());
+  readCommand(SPIFLASH_ARRAYREAD, addr, len);
+  SPIFLASHA_TRACED(traceAddress(addr, len));
+  sendAddress(addr);
+  send(0); //"dont care"
+  receive((byte*) buf, len);
   unselect();
+  SPIFLASHA_STAT(_stats.bytesRead += len);
+  SPIFLASHA_HISTO(_histogram[SPIFLASHHISTO_READ].add(micros() - start));
+}
+
+/// read len bytes into a sink, in chunks of SPIFLASHSINK_CHUNK bytes of a single FAST_READ whatever len is
+/// when the sink shares the SPI bus (SPIFlashSink::sharesBus()) the flash is released before each chunk is given to
+/// it and the next chunk is read by a new FAST_READ, without waiting for the chip that is idle since the first one
+/// returns the number of bytes given to the sink (less than len if it stopped the read)
+long SPIFlashA::readTo(long addr, long len, SPIFlashSink& sink) {
+  byte chunk[SPIFLASHSINK_CHUNK];
+  boolean shared = sink.sharesBus();
+  long done = 0;
+  while (done < len) {
+    byte n = len - done < SPIFLASHSINK_CHUNK ? len - done : SPIFLASHSINK_CHUNK;
+    if (done == 0 || shared) {
+      long count = shared ? n : len;
+      if (done == 0 || _eraseSize > 0)		// First chunk, or the erase it suspended has resumed
+        readCommand(SPIFLASH_ARRAYREAD, addr, count);
+      else {
+        SPIFLASHA_TRACED(traceStart(SPIFLASH_ARRAYREAD));
+        select();
+        send(SPIFLASH_ARRAYREAD);
+        SPIFLASHA_STAT(_stats.commands[opcodeIndex(SPIFLASH_ARRAYREAD)]++);
+        SPIFLASHA_TRACED(_traceOpen = true; _traceWaiting = false);
+      }
+      SPIFLASHA_TRACED(traceAddress(addr, count > 0xFFFF ? 0xFFFF : count));
+      sendAddress(addr);
+      send(0); //"dont care"
+    }
+    receive(chunk, n);
+    if (shared)
+      unselect();
+    else
+      flush();
+    SPIFLASHA_STAT(_stats.bytesRead += n);
+    addr += n;
+    done += n;
+    if (!sink.take(chunk, n))
+      break;
+  }
+  if (!shared && done)
+    unselect();
+  return done;
+}
+
+/// read a batch of n requests, sorting them by address (the array is reordered) and merging the ones separated by at
+/// most gap bytes in a single FAST_READ whose unused bytes are discarded. Returns the number of FAST_READ sent
+byte SPIFlashA::readMany(SPIFlashRead* requests, byte n, word gap) {
+  for (byte i = 1; i < n; i++) {
+    SPIFlashRead request = requests[i];
+    byte j = i;
+    for (; j > 0 && requests[j - 1].addr > request.addr; j--)
+      requests[j] = requests[j - 1];
+    requests[j] = request;
+  }
+  byte transactions = 0;
+  byte i = 0;
+  while (i < n) {
+    long start = requests[i].addr;
+    long pos = start;
+    // Requests i .. last-1 are merged in start .. stop-1, requests overlapping the data already read start a new FAST_READ
+    byte last = i + 1;
+    long stop = start + requests[i].len;
+    while (last < n && requests[last].addr >= stop && requests[last].addr - stop <= gap) {
+      stop = requests[last].addr + requests[last].len;
+      last++;
+    }
+    readCommand(SPIFLASH_ARRAYREAD, start, stop - start);
+    sendAddress(pos);
+    send(0); //"dont care"
+    transactions++;
+    for (; i < last; i++) {
+      for (; pos < requests[i].addr; pos++)
+        send(0);
+      receive((byte*) requests[i].buf, requests[i].len);
+      pos += requests[i].len;
+      SPIFLASHA_STAT(_stats.bytesRead += requests[i].len);
+    }
+    SPIFLASHA_TRACED(traceAddress(start, stop - start));
+    unselect();
+  }
+  return transactions;
 }
 
 /// Send a command to the flash chip, pass TRUE for isWrite when its a write command
@@ -153,29 +305,152 @@ void SPIFlashA::command(byte cmd, boolean isWrite){
     command(SPIFLASH_WRITEENABLE); // Write Enable
     unselect();
   }
+  SPIFLASHA_TRACED(traceStart(cmd));
   //wait for any write/erase to complete
   //  a time limit cannot really be added here without it being a very large safe limit
   //  that is because some chips can take several seconds to carry out a chip erase or other similar multi block or entire-chip operations
   //  a recommended alternative to such situations where chip can be or not be present is to add a 10k or similar weak pulldown on the
   //  open drain MISO input which can read noise/static and hence return a non 0 status byte, causing the while() to hang when a flash chip is not present
-  while(busy());
+  //  a read that suspended the erase in progress (see readCommand()) does not wait
+  if (!_suspended)
+  {
+#if defined(SPIFLASHA_STATS) || defined(SPIFLASHA_HISTOGRAM)
+    SPIFLASHA_STAT(byte op = _statsOp);
+    unsigned long waitStart = micros();
+    SPIFLASHA_HISTO(boolean waiting =) waitReady();
+    SPIFLASHA_STAT(waited(op, micros() - waitStart));
+    SPIFLASHA_HISTO(if (waiting) _histogram[SPIFLASHHISTO_WAIT].add(micros() - waitStart));
+#else
+    waitReady();
+#endif
+  }
   select();
-  SPI.transfer(cmd);
+  send(cmd);
+  SPIFLASHA_STAT(_stats.commands[opcodeIndex(cmd)]++);
+  SPIFLASHA_TRACED(_traceOpen = true; _traceWaiting = false);
+}
+
+/// send a read command for addr .. addr+len-1, with setEraseSuspend() the 4K or 64K sector erase in progress is
+/// suspended instead of waited for when the range is outside of the sector (the erased sector itself cannot be read
+/// while suspended, and a bulk erase cannot be suspended)
+void SPIFlashA::readCommand(byte cmd, long addr, long len) {
+  if (_eraseSuspend && _eraseSize > 0 && (addr + len <= _eraseAddr || addr >= _eraseAddr + _eraseSize))
+    suspendErase();
+  command(cmd);
 }
 
 /// check if the chip is busy erasing/writing
 boolean SPIFlashA::busy()
 {
-  return readStatus() & 1;
+  SPIFLASHA_STAT(_stats.busyPolls++);
+  SPIFLASHA_TRACED(if (_traceWaiting) _trace[_traceCurrent].polls++);
+  if (readStatus() & 1)
+    return true;
+  ready();
+  return false;
+}
+
+/// wait until the chip is ready, returns true if it was busy
+/// RDSR is sent once and the status register is clocked out continuously until WIP clears (saving the chip select, SPI
+/// setup and opcode of each busy() poll), the chip is released every SPIFLASHWAIT_WINDOW us to service the interrupts
+boolean SPIFlashA::waitReady()
+{
+  boolean waited = false;
+  byte status;
+  do {
+    select();
+    send(SPIFLASH_STATUSREAD);
+    SPIFLASHA_STAT(_stats.commands[opcodeIndex(SPIFLASH_STATUSREAD)]++; _stats.statusBytes++);
+    unsigned long start = micros();
+    do {
+      status = transfer(0);
+      SPIFLASHA_STAT(_stats.busyPolls++; _stats.statusBytes++);
+      SPIFLASHA_TRACED(if (_traceWaiting) _trace[_traceCurrent].polls++);
+    } while ((status & 1) && micros() - start < SPIFLASHWAIT_WINDOW);
+    unselect();
+    if (status & 1)
+      waited = true;
+  } while (status & 1);
+  ready();
+  return waited;
+}
+
+/// the chip was seen ready: end of the program or erase in progress
+void SPIFlashA::ready()
+{
+  SPIFLASHA_STAT(_statsOp = SPIFLASHSTATS_NONE);
+  if (_eraseSize) {				// First time the end of an erase is seen: report its duration
+    long size = _eraseSize;
+    unsigned long duration = micros() - _eraseStart;
+    _eraseSize = 0;
+    SPIFLASHA_HISTO(_histogram[SPIFLASHHISTO_ERASE].add(duration));
+    if (_eraseListener)
+      _eraseListener->eraseDone(_eraseAddr, size, duration);
+  }
+}
+
+/// suspend the erase in progress for a read (after letting it run SPIFLASHSUSPEND_GAP since the last resume), false if
+/// the erase is over: the read then goes through the usual wait of command()
+boolean SPIFlashA::suspendErase() {
+  while (micros() - _resumeTime < SPIFLASHSUSPEND_GAP)
+    if (!(readStatus() & 1))
+      return false;
+  select();
+  send(SPIFLASH_ERASESUSPEND);
+  unselect();
+  while (readStatus() & 1);			// Suspend latency (tSL: 45 us max)
+  if (!(readRegister(SPIFLASH_STATUSREAD2) & 2))	// ES clear: the erase finished before the suspend
+    return false;
+  _suspended = true;
+  return true;
+}
+
+/// remember the erase just started (size -1 for a bulk erase) for readCommand(), the listener and the erase histogram
+void SPIFlashA::eraseStarted(long addr, long size) {
+  _eraseAddr = size > 0 ? addr & ~(size - 1) : addr;	// Start of the sector the chip erases, whatever addr is in it
+  _eraseSize = size;
+  _eraseStart = micros();
 }
 
 /// return the STATUS register
 byte SPIFlashA::readStatus()
+{
+  return readRegister(SPIFLASH_STATUSREAD);
+}
+
+/// read a register (RDSR1, RDSR2 or RDCR), each one needs its own chip select but none waits for the chip to be ready
+byte SPIFlashA::readRegister(byte cmd)
 {
   select();
-  SPI.transfer(SPIFLASH_STATUSREAD);
-  byte status = SPI.transfer(0);
+  send(cmd);
+  byte value = transfer(0);
   unselect();
+  SPIFLASHA_STAT(_stats.commands[opcodeIndex(cmd)]++);
+  SPIFLASHA_STAT(if (cmd == SPIFLASH_STATUSREAD) _stats.statusBytes += 2);
+  return value;
+}
+
+/// return the status registers 1 and 2 and the configuration register decoded, in 3 short transactions
+SPIFlashStatus SPIFlashA::readStatusAll()
+{
+  SPIFlashStatus status;
+  byte sr1 = readRegister(SPIFLASH_STATUSREAD);
+  byte sr2 = readRegister(SPIFLASH_STATUSREAD2);
+  byte cr = readRegister(SPIFLASH_CONFIGREAD);
+  status.wip = sr1;
+  status.wel = sr1 >> 1;
+  status.bp = sr1 >> 2;
+  status.eErr = sr1 >> 5;
+  status.pErr = sr1 >> 6;
+  status.srwd = sr1 >> 7;
+  status.ps = sr2;
+  status.es = sr2 >> 1;
+  status.freeze = cr;
+  status.quad = cr >> 1;
+  status.tbparm = cr >> 2;
+  status.bpnv = cr >> 3;
+  status.tbprot = cr >> 5;
+  status.lc = cr >> 6;
   return status;
 }
 
@@ -185,11 +460,11 @@ byte SPIFlashA::readStatus()
 ///          use the block erase commands to first clear memory (write 0xFFs)
 void SPIFlashA::writeByte(long addr, uint8_t byt) {
   command(SPIFLASH_BYTEPAGEPROGRAM, true);  // Byte/Page Program
-  SPI.transfer(addr >> 16);
-  SPI.transfer(addr >> 8);
-  SPI.transfer(addr);
-  SPI.transfer(byt);
+  SPIFLASHA_TRACED(traceAddress(addr, 1));
+  sendAddress(addr);
+  send(byt);
   unselect();
+  SPIFLASHA_STAT(_stats.bytesWritten++; _statsOp = SPIFLASHSTATS_PROGRAM);
 }
 
 /// write 1-256 bytes to flash memory
@@ -200,12 +475,102 @@ void SPIFlashA::writeByte(long addr, uint8_t byt) {
 ///          see datasheet for more details
 void SPIFlashA::writeBytes(long addr, const void* buf, uint16_t len) {
   command(SPIFLASH_BYTEPAGEPROGRAM, true);  // Byte/Page Program
-  SPI.transfer(addr >> 16);
-  SPI.transfer(addr >> 8);
-  SPI.transfer(addr);
-  for (uint16_t i = 0; i < len; i++)
-    SPI.transfer(((byte*) buf)[i]);
+  SPIFLASHA_TRACED(traceAddress(addr, len));
+  sendAddress(addr);
+  send((const byte*) buf, len);
+  unselect();
+  SPIFLASHA_STAT(_stats.bytesWritten += len; _statsOp = SPIFLASHSTATS_PROGRAM);
+}
+
+/// program len bytes at value from addr, page by page (any length and alignment) with the value streamed in each Page
+/// Program instead of a page buffer. Filling with 0xFF does not change the memory, it returns without a command
+/// WARNING: as for writeBytes() the memory must be erased, the last page may still be programming on return
+void SPIFlashA::fillBytes(long addr, long len, byte value) {
+  if (value == 0xFF)
+    return;
+  while (len > 0) {
+    word n = 256 - (addr & 255);
+    if (n > len) n = len;
+    command(SPIFLASH_BYTEPAGEPROGRAM, true);  // Byte/Page Program
+    SPIFLASHA_TRACED(traceAddress(addr, n));
+    sendAddress(addr);
+    for (word i = 0; i < n; i++)
+      send(value);
+    unselect();
+    SPIFLASHA_STAT(_stats.bytesWritten += n; _statsOp = SPIFLASHSTATS_PROGRAM);
+    addr += n;
+    len -= n;
+  }
+}
+
+/// write len bytes produced by a source, page by page: the next page is produced in RAM while the chip programs the
+/// previous one, so the source time overlaps the program time. Returns the number of bytes written (less than len
+/// if the source ended the write)
+/// WARNING: as for writeBytes() the memory must be erased, the last page may still be programming on return
+long SPIFlashA::writeFrom(long addr, long len, SPIFlashSource& source) {
+  byte page[256];
+  long done = 0;
+  while (done < len) {
+    word room = 256 - (addr & 255);
+    if (room > len - done) room = len - done;
+    word n = 0;
+    while (n < room) {
+      word got = source.give(page + n, room - n);
+      if (!got)
+        break;
+      n += got;
+    }
+    if (n)
+      writeBytes(addr, page, n);			// command() waits for the previous page here
+    done += n;
+    addr += n;
+    if (n < room)
+      break;
+  }
+  return done;
+}
+
+/// copy len bytes from src to dst through a page of RAM. copyRange() never erases: the caller must erase the destination
+/// beforehand, and it must not overlap the source
+/// The bytes at 0xFF are not programmed: an erased source page costs its read only, a partly used one is programmed
+/// from its first to its last programmed byte. With verify each destination page is read back and compared, returns
+/// false if one differs.
+/// NOTE: the chip cannot be read while it programs, so reading the next source page waits for the previous program
+boolean SPIFlashA::copyRange(long src, long dst, long len, boolean verify) {
+  byte page[256];
+  boolean ok = true;
+  while (len > 0) {
+    word n = 256 - (dst & 255);
+    if (n > len) n = len;
+    readBytes(src, page, n);
+    word first = 0, last = n;
+    while (first < n && page[first] == 0xFF) first++;
+    while (last > first && page[last - 1] == 0xFF) last--;
+    if (first < last) {
+      writeBytes(dst + first, page + first, last - first);
+      if (verify && !compareBytes(dst + first, page + first, last - first))
+        ok = false;
+    }
+    src += n;
+    dst += n;
+    len -= n;
+  }
+  return ok;
+}
+
+/// compare len bytes of flash memory with buf on the fly, in a single FAST_READ without a second buffer
+boolean SPIFlashA::compareBytes(long addr, const byte* buf, word len) {
+  boolean same = true;
+  readCommand(SPIFLASH_ARRAYREAD, addr, len);
+  SPIFLASHA_TRACED(traceAddress(addr, len));
+  sendAddress(addr);
+  send(0); //"dont care"
+  for (word i = 0; i < len; ++i)
+    if (transfer(0) != buf[i])
+      same = false;
   unselect();
+  SPIFLASHA_STAT(_stats.bytesRead += len);
+  return same;
 }
 
 /// erase entire flash memory array
@@ -217,6 +582,8 @@ void SPIFlashA::writeBytes(long addr, const void* buf, uint16_t len) {
 void SPIFlashA::bulkErase() {
   command(SPIFLASH_CHIPERASE, true);
   unselect();
+  SPIFLASHA_STAT(_statsOp = SPIFLASHSTATS_BULKERASE);
+  eraseStarted(0, -1);
 }
 
 /// erase 512 KBytes of memory (equivalent size of a WINBOND W25X40CL Moteino memory)
@@ -233,10 +600,11 @@ void SPIFlashA::chipErase() {
 /// erase a 4Kbyte block
 void SPIFlashA::blockErase4K(long addr) {
   command(SPIFLASH_BLOCKERASE_4K, true); // Block Erase
-  SPI.transfer(addr >> 16);
-  SPI.transfer(addr >> 8);
-  SPI.transfer(addr);
+  SPIFLASHA_TRACED(traceAddress(addr, 0));
+  sendAddress(addr);
   unselect();
+  SPIFLASHA_STAT(_statsOp = SPIFLASHSTATS_ERASE4K);
+  eraseStarted(addr, 4096);
 }
 
 /// erase a 32Kbyte block
@@ -251,10 +619,11 @@ void SPIFlashA::blockErase32K(long addr) {
 /// erase a 64Kbyte block
 void SPIFlashA::blockErase64K(long addr) {
   command(SPIFLASH_BLOCKERASE_64K, true); // Block Erase
-  SPI.transfer(addr >> 16);
-  SPI.transfer(addr >> 8);
-  SPI.transfer(addr);
+  SPIFLASHA_TRACED(traceAddress(addr, 0));
+  sendAddress(addr);
   unselect();
+  SPIFLASHA_STAT(_statsOp = SPIFLASHSTATS_ERASE64K);
+  eraseStarted(addr, 65536);
 }
 /// erase a 512Kbyte block
 void SPIFlashA::blockErase512K(long addr) {
@@ -265,24 +634,51 @@ void SPIFlashA::blockErase512K(long addr) {
   }
 }
 
+/// start an incremental erase of from .. to-1, carried out by step() one 64K sector at a time
+/// the range is rounded inward to whole 64K sectors (from up, to down) so that nothing outside of it is erased: an
+/// unaligned from or to leaves the partial sector at that end as it is, a range without a whole sector erases nothing
+/// the memory from the rounded from to erasedTo() can be written while the rest is still being erased
+void SPIFlashA::beginFullErase(long from, long to) {
+  _erasedTo = _eraseNext = (from + 0xFFFFL) & ~0xFFFFL;
+  _eraseEnd = to & ~0xFFFFL;
+  if (_eraseEnd < _eraseNext)
+    _eraseEnd = _eraseNext;
+}
+
+/// carry out the incremental erase for up to budget us (0: start the next sector if the chip is ready, never wait)
+/// the end of a sector erase moves erasedTo() and starts the next one. Returns true while the erase is not over
+boolean SPIFlashA::step(unsigned long budget) {
+  unsigned long start = micros();
+  while (_erasedTo < _eraseEnd) {
+    if (busy()) {
+      if (micros() - start >= budget)
+        return true;
+      continue;
+    }
+    _erasedTo = _eraseNext;			// The chip is ready: the last sector started is erased
+    if (_eraseNext < _eraseEnd) {
+      blockErase64K(_eraseNext);
+      _eraseNext += 0x10000;
+    }
+  }
+  return false;
+}
+
 /// Print the STATUS register 1&2
 void SPIFlashA::printStatus()
 {
-  select();
-  SPI.transfer(SPIFLASH_STATUSREAD);
-  Serial.print ("\n\rStatus Register 1 (Binary): "),Serial.println (SPI.transfer(0),BIN);
-  SPI.transfer(SPIFLASH_STATUSREAD2);
-  Serial.print ("Status Register 2 (Binary): "),Serial.println (SPI.transfer(0),BIN);
-  unselect();
+  Serial.print ("\n\rStatus Register 1 (Binary): "),Serial.println (readRegister(SPIFLASH_STATUSREAD),BIN);
+  Serial.print ("Status Register 2 (Binary): "),Serial.println (readRegister(SPIFLASH_STATUSREAD2),BIN);
+  Serial.print ("Configuration Register (Binary): "),Serial.println (readRegister(SPIFLASH_CONFIGREAD),BIN);
 }
 
 /// Print 320 Bytes of the Manufacturer ID and Common Flash Information table (CFI)
 void SPIFlashA::printRDID() {
  long rdid ;
   select ();
-    SPI.transfer(SPIFLASH_IDREAD);
+    transfer(SPIFLASH_IDREAD);
   for(int i=0; i<320; i++) {
-     byte b = SPI.transfer(0x00);
+     byte b = transfer(0x00);
      rdid += b;
      if(i>0 && i%32 ==0) Serial.println();
      if(b<0x10) Serial.print("0");
@@ -294,6 +690,132 @@ void SPIFlashA::printRDID() {
 }
 
 
+#ifdef SPIFLASHA_STATS
+/// Opcodes counted in SPIFlashStats.commands[], any other opcode is counted in the last entry
+static const byte STATSOPCODES[SPIFLASHSTATS_OPCODES - 1] = {
+  SPIFLASH_STATUSWRITE, SPIFLASH_BYTEPAGEPROGRAM, SPIFLASH_ARRAYREADLOWFREQ, SPIFLASH_WRITEDISABLE, SPIFLASH_STATUSREAD,
+  SPIFLASH_WRITEENABLE, SPIFLASH_STATUSREAD2, SPIFLASH_ARRAYREAD, SPIFLASH_BLOCKERASE_4K, SPIFLASH_CHIPERASE,
+  SPIFLASH_MACREAD, SPIFLASH_IDREAD, SPIFLASH_BLOCKERASE_64K
+};
+static const char* const STATSOPNAMES[SPIFLASHSTATS_OPS] = { "PP", "P4E", "SE", "BE", "WRR" };
+
+/// index of an opcode in SPIFlashStats.commands[]
+byte SPIFlashA::opcodeIndex(byte cmd) {
+  byte i = 0;
+  while (i < SPIFLASHSTATS_OPCODES - 1 && STATSOPCODES[i] != cmd) i++;
+  return i;
+}
+
+/// clear the performance counters
+void SPIFlashA::resetStats() {
+  memset(&_stats, 0, sizeof(_stats));
+  _statsOp = SPIFLASHSTATS_NONE;
+  _statsSelected = false;
+}
+
+/// account a wait of command() for the end of operation op
+void SPIFlashA::waited(byte op, unsigned long duration) {
+  if (op == SPIFLASHSTATS_NONE)
+    return;
+  _stats.waits[op]++;
+  _stats.waitTotal[op] += duration;
+  if (duration > _stats.waitMax[op]) _stats.waitMax[op] = duration;
+}
+
+/// Print the performance counters
+void SPIFlashA::printStats() {
+  Serial.println ("\n\rOpcode: commands");
+  for (byte i = 0; i < SPIFLASHSTATS_OPCODES; i++) {
+    if (!_stats.commands[i]) continue;
+    if (i < SPIFLASHSTATS_OPCODES - 1) Serial.print (STATSOPCODES[i], HEX); else Serial.print ("other");
+    Serial.print (": "); Serial.println (_stats.commands[i]);
+  }
+  Serial.print ("Bytes read: "); Serial.println (_stats.bytesRead);
+  Serial.print ("Bytes written: "); Serial.println (_stats.bytesWritten);
+  Serial.print ("Busy polls: "); Serial.println (_stats.busyPolls);
+  for (byte op = 0; op < SPIFLASHSTATS_OPS; op++) {
+    if (!_stats.waits[op]) continue;
+    Serial.print ("Wait after "); Serial.print (STATSOPNAMES[op]); Serial.print (" (count/total us/max us): ");
+    Serial.print (_stats.waits[op]); Serial.print ('/'); Serial.print (_stats.waitTotal[op]); Serial.print ('/'); Serial.println (_stats.waitMax[op]);
+  }
+  Serial.print ("Selects: "); Serial.println (_stats.selects);
+  Serial.print ("Bus bytes: "); Serial.println (_stats.busBytes);
+  Serial.print ("Status bytes: "); Serial.println (_stats.statusBytes);
+  Serial.print ("Interrupts off (total us/max us): "); Serial.print (_stats.irqOffTotal); Serial.print ('/'); Serial.println (_stats.irqOffMax);
+}
+#endif
+
+#ifdef SPIFLASHA_HISTOGRAM
+/// count a duration (us) in its power of 2 bucket
+void SPIFlashHistogram::add(unsigned long duration) {
+  byte k = 0;
+  while (duration >>= 2)
+    k++;
+  if (k >= SPIFLASHHISTO_BUCKETS) k = SPIFLASHHISTO_BUCKETS - 1;
+  if (buckets[k] != 0xFF) buckets[k]++;
+}
+
+/// Print the non empty buckets as "from-to us: count"
+void SPIFlashHistogram::print(const char* name) {
+  Serial.print ("\n\r"); Serial.print (name); Serial.println (" (us: count)");
+  for (byte k = 0; k < SPIFLASHHISTO_BUCKETS; k++) {
+    if (!buckets[k]) continue;
+    Serial.print (k ? 1UL << (2 * k) : 0UL); Serial.print ('-');
+    if (k < SPIFLASHHISTO_BUCKETS - 1) Serial.print ((4UL << (2 * k)) - 1); else Serial.print ("...");
+    Serial.print (": "); Serial.println (buckets[k]);
+  }
+}
+
+/// Print the busy wait, readBytes and erase histograms
+void SPIFlashA::printHistograms() {
+  _histogram[SPIFLASHHISTO_WAIT].print("Busy wait");
+  _histogram[SPIFLASHHISTO_READ].print("readBytes");
+  _histogram[SPIFLASHHISTO_ERASE].print("Erase");
+}
+#endif
+
+#ifdef SPIFLASHA_TRACE
+/// open the trace entry of a command, before its busy wait
+void SPIFlashA::traceStart(byte cmd) {
+  _traceCurrent = _traceCount++ % SPIFLASHTRACE_SIZE;
+  SPIFlashTraceEntry& entry = _trace[_traceCurrent];
+  entry.opcode = cmd;
+  entry.addr = -1;
+  entry.len = 0;
+  entry.polls = 0;
+  entry.start = micros();
+  entry.end = 0;
+  _traceWaiting = true;
+}
+
+/// entry i of the trace, 0 is the oldest command still recorded, traceCount()-1 the last one
+const SPIFlashTraceEntry& SPIFlashA::trace(byte i) {
+  byte first = _traceCount < SPIFLASHTRACE_SIZE ? 0 : _traceCount % SPIFLASHTRACE_SIZE;
+  return _trace[(first + i) % SPIFLASHTRACE_SIZE];
+}
+
+void SPIFlashA::clearTrace() {
+  _traceCount = 0;
+  _traceCurrent = 0;
+  _traceOpen = _traceWaiting = false;
+}
+
+/// Print the recorded commands, oldest first: opcode, address, length, busy polls, start (us), duration (us)
+void SPIFlashA::printTrace() {
+  Serial.println ("\n\rOpcode Address Length Polls Start(us) Duration(us)");
+  for (byte i = 0; i < traceCount(); i++) {
+    const SPIFlashTraceEntry& entry = trace(i);
+    Serial.print (entry.opcode, HEX); Serial.print (' ');
+    if (entry.addr < 0) Serial.print ('-'); else Serial.print (entry.addr, HEX);
+    Serial.print (' '); Serial.print (entry.len);
+    Serial.print (' '); Serial.print (entry.polls);
+    Serial.print (' '); Serial.print (entry.start);
+    Serial.print (' ');
+    if (entry.end) Serial.println (entry.end - entry.start); else Serial.println ("in progress");
+  }
+}
+#endif
+
 void SPIFlashA::sleep() {
 //  command(SPIFLASH_SLEEP);		// NOOP FOR SPANSION
 //  unselect();
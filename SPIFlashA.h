@@ -24,7 +24,8 @@
  *				1st Byte:  0x01 Manufacturer ID for Spansion
  *				2nd Byte:  0x20 (128 Mb) Device ID Most Significant Byte - Memory Interface Type *				3rd Byte:  0x18 (128 Mb) Device ID Least Significant Byte - Density 
  *		6. A new command printRDID (), is implemented to dump the Manufacturer and Device ID 320Bytes table
- *		7. A new command printStatus(), is implemented to print the status registers 1 and 2 
+ *		7. A new command printStatus(), is implemented to print the status registers 1 and 2 and the configuration register
+ *		8. A new command readStatusAll(), returns the 3 registers decoded (SPIFlashStatus) for the code that needs more than the busy bit
  *
  * This file is free software; you can redistribute it and/or modify
  * it under the terms of either the GNU General Public License version 2
@@ -43,6 +44,42 @@
 
 #include <SPI.h>
 
+/// Uncomment to keep performance counters inside SPIFlashA (see SPIFlashStats, readStats(), resetStats() and printStats())
+/// When it is commented out the counters take no RAM and no code
+//#define SPIFLASHA_STATS
+
+#ifdef SPIFLASHA_STATS
+#define SPIFLASHA_STAT(x) x
+#else
+#define SPIFLASHA_STAT(x)
+#endif
+
+/// Uncomment to keep latency histograms of the command() busy waits, readBytes() and erases (see SPIFlashHistogram)
+//#define SPIFLASHA_HISTOGRAM
+
+#ifdef SPIFLASHA_HISTOGRAM
+#define SPIFLASHA_HISTO(x) x
+#else
+#define SPIFLASHA_HISTO(x)
+#endif
+
+/// Uncomment to record the last SPIFLASHTRACE_SIZE commands in a ring buffer (see SPIFlashTraceEntry and printTrace())
+//#define SPIFLASHA_TRACE
+
+#ifdef SPIFLASHA_TRACE
+#define SPIFLASHA_TRACED(x) x
+#else
+#define SPIFLASHA_TRACED(x)
+#endif
+
+/// Uncomment to let a SPIFlashTransport replace the SPI bus and slave select pin (setTransport()), at the cost of a test
+/// per byte. Always defined on Linux, for SPIFlashSpidev
+//#define SPIFLASHA_TRANSPORT
+
+#if defined(__linux__) && !defined(SPIFLASHA_TRANSPORT)
+#define SPIFLASHA_TRANSPORT
+#endif
+
 /// IMPORTANT: NAND FLASH memory requires erase before write, because
 ///            it can only transition from 1s to 0s and only the erase command can reset all 0s to 1s
 /// See http://en.wikipedia.org/wiki/Flash_memory
@@ -61,14 +98,142 @@
 #define SPIFLASH_STATUSREAD2      0x07        // read status register 2 - RDSR2
 #define SPIFLASH_ARRAYREAD        0x0B        // Fast read array (Need to add 1 dummy byte after 3 address bytes) - FAST_READ
 #define SPIFLASH_BLOCKERASE_4K    0x20        // erase one 4K block of flash memory - P4E
+#define SPIFLASH_CONFIGREAD       0x35        // read configuration register - RDCR
 #define SPIFLASH_CHIPERASE        0x60        // Bulk Erase (may take several seconds depending on size) - BE
+#define SPIFLASH_ERASESUSPEND     0x75        // erase suspend - ERSP
+#define SPIFLASH_ERASERESUME      0x7A        // erase resume - ERRS
 //#define SPIFLASH_BLOCKERASE_32K   0x52        // Erase one 32K block of flash memory Not implemenetd for SPANION
 #define SPIFLASH_MACREAD          0x4B        // One Time Program read (OTP)
 #define SPIFLASH_IDREAD           0x9f        // read JEDEC manufacturer and device ID (3 bytes, specific bytes for each manufacturer and device)
 //#define SPIFLASH_WAKE             0xAB      	// As another meaning for SPANSION than WINBOND deep power wake up
 //#define SPIFLASH_SLEEP            0xB9        // As another meaning for SPANSION than WINBOND deep power down
 #define SPIFLASH_BLOCKERASE_64K   0xD8        // erase one 64K block of flash memory
+
+#define SPIFLASHWAIT_WINDOW       200         // Longest chip select (us, interrupts disabled) of a waitReady() poll
+#define SPIFLASH_SIZE             0x1000000   // S25FL127S: 16 MBytes (default end of beginFullErase())
+#define SPIFLASHSUSPEND_GAP       1000        // Shortest erase time (us) between two suspends, so that the erase progresses
+#define SPIFLASHSINK_CHUNK        32          // Bytes per SPIFlashSink::take() call of readTo()
+#define SPIFLASHREAD_GAP          16          // readMany(): unused bytes read rather than starting a new FAST_READ
                                               
+/// Status and configuration registers of the S25FL127S (readStatusAll())
+struct SPIFlashStatus {
+  // Status Register 1
+  byte wip:1;                                 // Write In Progress (program, erase or register write)
+  byte wel:1;                                 // Write Enable Latch
+  byte bp:3;                                  // Block Protection BP2..BP0
+  byte eErr:1;                                // Erase error (cleared by CLSR 0x30)
+  byte pErr:1;                                // Program error (cleared by CLSR 0x30)
+  byte srwd:1;                                // Status Register Write Disable
+  // Status Register 2
+  byte ps:1;                                  // Program Suspended
+  byte es:1;                                  // Erase Suspended
+  // Configuration Register
+  byte freeze:1;                              // Lock of the BP bits and OTP regions until the next power cycle
+  byte quad:1;                                // Quad I/O mode
+  byte tbparm:1;                              // 4K parameter sectors at the top (1) or bottom (0) of the array
+  byte bpnv:1;                                // BP bits volatile (1) or non volatile (0)
+  byte tbprot:1;                              // Block protection from the bottom (1) or the top (0) of the array
+  byte lc:2;                                  // Latency code
+};
+
+/// Performance counters (SPIFLASHA_STATS)
+#define SPIFLASHSTATS_OPCODES     14          // Counted opcodes, see SPIFlashA::opcodeIndex() (last one is "other")
+#define SPIFLASHSTATS_NONE        0xFF        // Operation types the chip can be busy with (index of waits/waitTotal/waitMax)
+#define SPIFLASHSTATS_PROGRAM     0
+#define SPIFLASHSTATS_ERASE4K     1
+#define SPIFLASHSTATS_ERASE64K    2
+#define SPIFLASHSTATS_BULKERASE   3
+#define SPIFLASHSTATS_WRITESTATUS 4
+#define SPIFLASHSTATS_OPS         5
+
+struct SPIFlashStats {
+  unsigned long commands[SPIFLASHSTATS_OPCODES];  // Commands sent, per opcode
+  unsigned long bytesRead;                        // Data bytes read / written (address, dummy and status bytes excluded)
+  unsigned long bytesWritten;
+  unsigned long busyPolls;                        // Status register reads done by busy()
+  unsigned long waits[SPIFLASHSTATS_OPS];         // Waits of command() for the chip, per operation the chip was busy with
+  unsigned long waitTotal[SPIFLASHSTATS_OPS];     // us
+  unsigned long waitMax[SPIFLASHSTATS_OPS];       // us
+  unsigned long selects;
+  unsigned long busBytes;                         // Bytes clocked on the bus: opcodes, addresses, dummy, data and status
+  unsigned long statusBytes;                      // Part of busBytes spent reading status register 1 (busy polls)
+  unsigned long irqOffTotal;                      // us with interrupts disabled between select() and unselect()
+  unsigned long irqOffMax;                        // us
+};
+
+/// Latency histogram (SPIFLASHA_HISTOGRAM): bucket k counts the durations of 4^k to 4^(k+1)-1 us (bucket 0: 0 to 3 us),
+/// the last bucket also counts everything longer. The counters stop at 255.
+#define SPIFLASHHISTO_BUCKETS     12          // Up to 16.7 s
+#define SPIFLASHHISTO_WAIT        0           // Histograms: command() waits for a busy chip
+#define SPIFLASHHISTO_READ        1           // readBytes() calls
+#define SPIFLASHHISTO_ERASE       2           // Erase command to the first busy() seeing the chip ready
+#define SPIFLASHHISTO_COUNT       3
+
+struct SPIFlashHistogram {
+  byte buckets[SPIFLASHHISTO_BUCKETS];
+  void add(unsigned long duration);
+  void print(const char* name);
+};
+
+/// Command trace (SPIFLASHA_TRACE): one entry per command() sent to the chip, the status polls done while the command
+/// waits for the chip are counted in its entry instead of being recorded (a busy() outside of a command is not counted)
+#define SPIFLASHTRACE_SIZE        16          // Entries of the ring buffer (17 bytes each)
+
+struct SPIFlashTraceEntry {
+  byte opcode;
+  long addr;                                  // -1 for a command without address
+  word len;                                   // Data bytes read or written
+  word polls;                                 // Status polls before the command could be sent
+  unsigned long start;                        // micros() when command() was called (the busy wait is included)
+  unsigned long end;                          // micros() at unselect(), 0 while the command is in progress
+};
+
+/// One read of a readMany() batch
+struct SPIFlashRead {
+  long addr;
+  void* buf;
+  word len;
+};
+
+/// Notified by SPIFlashA when an erase completes (detected by busy()), with its duration measured up to the first busy()
+/// that saw the chip ready: an upper bound, the time the chip stayed idle before that busy() is included
+/// size is 4096, 65536 or -1 for a bulkErase(). eraseDone() is called from inside busy() and must not access the flash
+class SPIFlashEraseListener {
+public:
+  virtual void eraseDone(long addr, long size, unsigned long duration) = 0;
+};
+
+/// Receives the data of readTo() in chunks of up to SPIFLASHSINK_CHUNK bytes, straight from its single FAST_READ
+/// take() is called with the flash selected and the interrupts disabled, unless sharesBus() returns true: the flash is
+/// then released before each take() call, which may use the SPI bus (radio...). take() must not access the flash,
+/// returning false stops the read
+class SPIFlashSink {
+public:
+  virtual boolean take(const byte* data, byte len) = 0;
+  virtual boolean sharesBus() { return false; }
+};
+
+/// Bus replacing the SPI and slave select pin of SPIFlashA (setTransport(), SPIFLASHA_TRANSPORT), see SPIFlashSpidev
+/// transfer() returns the byte received at once. send() and receive() may queue their bytes until the next transfer(),
+/// flush() or unselect(): receive() fills buf by then at the latest
+class SPIFlashTransport {
+public:
+  virtual void select() = 0;
+  virtual void unselect() = 0;
+  virtual byte transfer(byte b) = 0;
+  virtual void send(byte b) { transfer(b); }
+  virtual void send(const byte* buf, word len) { for (word i = 0; i < len; i++) transfer(buf[i]); }
+  virtual void receive(byte* buf, word len) { for (word i = 0; i < len; i++) buf[i] = transfer(0); }
+  virtual void flush() {}
+};
+
+/// Produces the data of writeFrom(): give() copies up to len bytes to data and returns how many (0 ends the write)
+/// give() is called between transactions, while the previous page programs: it may wait and use the SPI bus
+class SPIFlashSource {
+public:
+  virtual word give(byte* data, word len) = 0;
+};
+
 class SPIFlashA {
 public:
   static byte UNIQUEID[12];						// Extended to 12 for SPANSION
@@ -76,32 +241,112 @@ public:
   boolean initialize();
   void command(byte cmd, boolean isWrite=false);
   byte readStatus();
+  SPIFlashStatus readStatusAll();
   void printStatus();
   void printRDID();
   byte readByte(long addr);
   void readBytes(long addr, void* buf, word len);
+  long readTo(long addr, long len, SPIFlashSink& sink);
+  byte readMany(SPIFlashRead* requests, byte n, word gap=SPIFLASHREAD_GAP);
   void writeByte(long addr, byte byt);
   void writeBytes(long addr, const void* buf, uint16_t len);
+  long writeFrom(long addr, long len, SPIFlashSource& source);
+  void fillBytes(long addr, long len, byte value);
+  boolean copyRange(long src, long dst, long len, boolean verify=false);
   boolean busy();
+  boolean waitReady();
   void chipErase();
   void bulkErase();
   void blockErase4K(long address);
   void blockErase32K(long address);
   void blockErase64K(long address);
   void blockErase512K(long address);		// New for SPANSION
+  void beginFullErase(long from=0, long to=SPIFLASH_SIZE);
+  boolean step(unsigned long budget=0);
+  long erasedTo() { return _erasedTo; }
   long readDeviceId();
   byte* readUniqueId();
   
   void sleep();
   void wakeup();
   void end();
+  void setEraseListener(SPIFlashEraseListener* listener) { _eraseListener = listener; }
+  void setEraseSuspend(boolean enable) { _eraseSuspend = enable; }
+#ifdef SPIFLASHA_TRANSPORT
+  void setTransport(SPIFlashTransport* transport) { _transport = transport; }
+#endif
+#ifdef SPIFLASHA_STATS
+  void readStats(SPIFlashStats& stats) { stats = _stats; }
+  void resetStats();
+  void printStats();
+  static byte opcodeIndex(byte cmd);
+#endif
+#ifdef SPIFLASHA_HISTOGRAM
+  const SPIFlashHistogram& histogram(byte which) { return _histogram[which]; }
+  void resetHistograms() { memset(_histogram, 0, sizeof(_histogram)); }
+  void printHistograms();
+#endif
+#ifdef SPIFLASHA_TRACE
+  byte traceCount() { return _traceCount < SPIFLASHTRACE_SIZE ? _traceCount : SPIFLASHTRACE_SIZE; }
+  const SPIFlashTraceEntry& trace(byte i);
+  void clearTrace();
+  void printTrace();
+#endif
 protected:
   void select();
   void unselect();
+  byte readRegister(byte cmd);
+  boolean compareBytes(long addr, const byte* buf, word len);
+  void readCommand(byte cmd, long addr, long len);
+#ifdef SPIFLASHA_TRANSPORT
+  byte transfer(byte b) { SPIFLASHA_STAT(_stats.busBytes++); return _transport ? _transport->transfer(b) : SPI.transfer(b); }
+  void send(byte b) { SPIFLASHA_STAT(_stats.busBytes++); if (_transport) _transport->send(b); else SPI.transfer(b); }
+  void flush() { if (_transport) _transport->flush(); }
+  SPIFlashTransport* _transport;
+#else
+  byte transfer(byte b) { SPIFLASHA_STAT(_stats.busBytes++); return SPI.transfer(b); }
+  void send(byte b) { transfer(b); }				// Byte whose result is ignored
+  void flush() {}						// Bytes sent and received so far are on the bus
+#endif
+  void sendAddress(long addr) { send(addr >> 16); send(addr >> 8); send(addr); }
+  void send(const byte* buf, word len);
+  void receive(byte* buf, word len);
+  void eraseStarted(long addr, long size);
+  void ready();
+  boolean suspendErase();
   byte _slaveSelectPin;
   long _jedecID;					// Changed form uint16_t to uint32_t for SPANSION
   byte _SPCR;
   byte _SPSR;
+  SPIFlashEraseListener* _eraseListener;
+  long _eraseAddr;				// Sector being erased (aligned on its size)
+  long _eraseSize;				// Size of the erase in progress (-1: bulk erase), 0 when none
+  unsigned long _eraseStart;			// micros() when the erase was started
+  long _erasedTo;				// Incremental erase: erased from its start up to here,
+  long _eraseNext;				// next 64K sector to erase
+  long _eraseEnd;
+  boolean _eraseSuspend;			// Reads suspend the erase in progress (setEraseSuspend())
+  boolean _suspended;				// The erase is suspended for the read in progress
+  unsigned long _resumeTime;			// micros() of the last erase resume
+#ifdef SPIFLASHA_STATS
+  void waited(byte op, unsigned long duration);
+  SPIFlashStats _stats;
+  byte _statsOp;				// Operation the chip may be busy with (SPIFLASHSTATS_NONE when ready)
+  boolean _statsSelected;
+  unsigned long _statsSelectTime;
+#endif
+#ifdef SPIFLASHA_HISTOGRAM
+  SPIFlashHistogram _histogram[SPIFLASHHISTO_COUNT];
+#endif
+#ifdef SPIFLASHA_TRACE
+  void traceStart(byte cmd);
+  void traceAddress(long addr, word len) { _trace[_traceCurrent].addr = addr; _trace[_traceCurrent].len = len; }
+  SPIFlashTraceEntry _trace[SPIFLASHTRACE_SIZE];
+  unsigned long _traceCount;			// Commands recorded since clearTrace()
+  byte _traceCurrent;				// Entry of the last command
+  boolean _traceOpen;				// The last command is selected (its end is recorded by unselect())
+  boolean _traceWaiting;			// The last command waits for the chip (the polls are counted in its entry)
+#endif
 };
 
 #endif
\ No newline at end of file
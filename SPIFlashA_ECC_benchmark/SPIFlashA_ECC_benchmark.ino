@@ -0,0 +1,58 @@
+/* SPIFlashECC overhead benchmark for Anarduino miniWireless.
+ * Measures the time of the table driven ECC kernel on a RAM page and compares the read throughput of
+ * SPIFlashA::readBytes() with SPIFlashECC::readBytes() (check and correction on the fly) on the same protected region.
+ * NOTE:  the protected region (64 KBytes at ECC_REGION) is erased and rewritten by this sketch
+*/
+#include <SPI.h>
+#include <SPIFlashA.h>
+#include <SPIFlashECC.h>
+#define FLASH_SS      5     // IMPORTANT: on Anarduino miniWireless the Flash SPI salve select is D5 (vs D8 on Moteino)
+#define ECC_REGION    0xF00000
+#define ECC_SIZE      0x10000
+
+SPIFlashECC flash(FLASH_SS, 0x12018, ECC_REGION, ECC_SIZE);
+byte page[256];
+byte ecc[3];
+
+void setup() {
+  Serial.begin (115200);
+  if (flash.initialize())
+    Serial.println("SPI Flash Init OK!");
+  else
+    Serial.println("SPI Flash Init FAIL!");
+
+  Serial.println ("Writing the protected region");
+  flash.blockErase64K(ECC_REGION);
+  for (int i = 0; i < 256; i++)
+    page[i] = i * 7;
+  for (long addr = ECC_REGION; addr < ECC_REGION + ECC_SIZE; addr += 256)
+    if ((addr & 0xF00) != 0xF00)
+      flash.writeBytes(addr, page, 256);
+  while (flash.busy());
+}
+
+void loop() {
+  long start = micros();
+  for (int i = 0; i < 100; i++)
+    SPIFlashECC::encode(page, ecc);
+  Serial.print ("ECC kernel (us per 256 bytes page): "); Serial.println ((micros() - start) / 100);
+
+  // Same number of pages in both cases: the 15 data pages of each sector
+  start = micros();
+  for (long addr = ECC_REGION; addr < ECC_REGION + ECC_SIZE; addr += 4096)
+    for (byte p = 0; p < 15; p++)
+      flash.SPIFlashA::readBytes(addr + p * 256L, page, 256);
+  long raw = micros() - start;
+  start = micros();
+  byte status = SPIFLASHECC_OK;
+  for (long addr = ECC_REGION; addr < ECC_REGION + ECC_SIZE; addr += 4096)
+    for (byte p = 0; p < 15; p++)
+      status |= flash.readBytes(addr + p * 256L, page, 256);
+  long checked = micros() - start;
+  Serial.print ("Plain read (us): "); Serial.println (raw);
+  Serial.print ("ECC read (us): "); Serial.println (checked);
+  Serial.print ("Overhead (%): "); Serial.println ((checked - raw) * 100 / raw);
+  Serial.print ("Status: "); Serial.print (status); Serial.print (" corrected: "); Serial.print (flash.corrected());
+  Serial.print (" errors: "); Serial.println (flash.errors());
+  delay (5000);
+}
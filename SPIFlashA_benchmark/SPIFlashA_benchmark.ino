@@ -0,0 +1,188 @@
+/* SPIFlashA benchmark for Anarduino miniWireless.
+ * Runs a fixed suite on a reserved scratch region and prints one CSV line per test, so that the results of two
+ * releases or two boards can be compared with a diff or a spreadsheet:
+ *   test,size,count,us_per_op,bytes_per_s
+ * size is the number of data bytes per operation (0 for the commands without data), bytes_per_s is 0 for them too.
+ * The lines starting with '#' are comments (chip identification, verification errors).
+ * The read_erase tests read a byte every ms during a 64K erase, waiting for the erase then suspending it
+ * (setEraseSuspend()): us_per_op is the average read latency, the _worst line the longest one.
+ * NOTE:  the scratch region (64 KBytes at SCRATCH) and the copy region (512 KBytes at COPY) are erased and rewritten by this sketch
+ *        Uncomment #define SPIFLASHA_STATS / SPIFLASHA_HISTOGRAM in SPIFlashA.h to also print the counters and latency histograms
+*/
+#include <SPI.h>
+#include <SPIFlashA.h>
+#define FLASH_SS      5     // IMPORTANT: on Anarduino miniWireless the Flash SPI salve select is D5 (vs D8 on Moteino)
+#define SCRATCH       0xFF0000
+#define SCRATCH_SIZE  0x10000
+#define COPY          0xF00000  // copyRange() source, the destination follows it
+#define COPY_SIZE     0x40000
+
+SPIFlashA flash(FLASH_SS, 0x12018);  // Create a SPANION SPI Flash instance
+byte buffer[256];
+unsigned long seed = 1;
+
+/* Print a CSV line, us is the total time of count operations of size bytes */
+void report(const char* test, long size, unsigned long count, unsigned long us) {
+  Serial.print (test); Serial.print (',');
+  Serial.print (size); Serial.print (',');
+  Serial.print (count); Serial.print (',');
+  Serial.print ((float) us / count, 2); Serial.print (',');
+  Serial.println (size && us ? (unsigned long) ((float) size * count * 1000000.0 / us) : 0);
+}
+
+/* Pseudo random offset in the scratch region (same sequence on every run) */
+long randomOffset(word size) {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) % (SCRATCH_SIZE - size);
+}
+
+/* Time of an erase until the chip is ready again, and the number of status polls done meanwhile */
+unsigned long timeErase(word kbytes, long addr, unsigned long& polls) {
+  unsigned long start = micros();
+  if (kbytes == 4) flash.blockErase4K(addr);
+  else if (kbytes == 32) flash.blockErase32K(addr);
+  else flash.blockErase64K(addr);
+  polls = 0;
+  while (flash.busy()) polls++;
+  return micros() - start;
+}
+
+void setup() {
+  Serial.begin (115200);
+  if (flash.initialize())
+    Serial.println("# SPI Flash Init OK!");
+  else
+    Serial.println("# SPI Flash Init FAIL!");
+  Serial.print("# JedecID: ");
+  Serial.println((long)flash.readDeviceId(), HEX);
+  Serial.print("# Unique ID: ");
+  flash.readUniqueId ();
+  for (int i = 0; i < 12; i++) {
+    Serial.print(flash.UNIQUEID[i], HEX);
+    if (i < 11) Serial.print('-');
+  }
+  Serial.println();
+}
+
+void loop() {
+  unsigned long start, us, polls;
+  static const word sizes[] = { 1, 16, 64, 256 };
+
+  Serial.println ("test,size,count,us_per_op,bytes_per_s");
+
+  /* Select / unselect overhead: RDSR is one select with the opcode and a single status byte */
+  start = micros();
+  for (word i = 0; i < 1000; i++)
+    flash.readStatus();
+  report ("select", 0, 1000, micros() - start);
+
+  /* Erases, the status polling rate is measured during the 64K erase */
+  us = timeErase(4, SCRATCH, polls);
+  report ("erase4K", 0, 1, us);
+  us = timeErase(32, SCRATCH, polls);
+  report ("erase32K", 0, 1, us);
+  us = timeErase(64, SCRATCH, polls);
+  report ("erase64K", 0, 1, us);
+  report ("status_poll", 0, polls, us);
+
+  /* Page program of the whole scratch region at each size, waiting for the end of each program */
+  for (byte s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    word size = sizes[s];
+    for (word i = 0; i < size; i++)
+      buffer[i] = i;
+    unsigned long count = 0;
+    flash.blockErase4K(SCRATCH);
+    start = micros();
+    for (long addr = SCRATCH; addr < SCRATCH + 4096; addr += size, count++) {
+      flash.writeBytes(addr, buffer, size);
+      while (flash.busy());
+    }
+    report ("program", size, count, micros() - start);
+  }
+
+  /* Reference content for the reads (and verification of the programs) */
+  timeErase(64, SCRATCH, polls);
+  for (word i = 0; i < 256; i++)
+    buffer[i] = i * 7;
+  for (long addr = SCRATCH; addr < SCRATCH + SCRATCH_SIZE; addr += 256)
+    flash.writeBytes(addr, buffer, 256);
+  while (flash.busy());
+  for (long addr = SCRATCH; addr < SCRATCH + SCRATCH_SIZE; addr += 256) {
+    flash.readBytes(addr, buffer, 256);
+    for (word i = 0; i < 256; i++)
+      if (buffer[i] != (byte) (i * 7)) {
+        Serial.print ("# Verify error at "); Serial.println (addr + i, HEX);
+        break;
+      }
+  }
+
+  /* Sequential and random reads */
+  for (byte s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    word size = sizes[s];
+    unsigned long count = 0;
+    start = micros();
+    for (long addr = SCRATCH; addr < SCRATCH + 16384; addr += size, count++)
+      flash.readBytes(addr, buffer, size);
+    report ("read_seq", size, count, micros() - start);
+    seed = 1;
+    start = micros();
+    for (word i = 0; i < 256; i++)
+      flash.readBytes(SCRATCH + randomOffset(size), buffer, size);
+    report ("read_random", size, 256, micros() - start);
+  }
+  start = micros();
+  for (word i = 0; i < 1024; i++)
+    flash.readByte(SCRATCH + i);
+  report ("readByte", 1, 1024, micros() - start);
+
+  /* Flash to flash copy of 256 KBytes, without and with verification */
+  for (long addr = COPY; addr < COPY + 2 * COPY_SIZE; addr += 0x10000)
+    timeErase(64, addr, polls);
+  for (word i = 0; i < 256; i++)
+    buffer[i] = i * 3;
+  for (long addr = COPY; addr < COPY + COPY_SIZE; addr += 256)
+    flash.writeBytes(addr, buffer, 256);
+  while (flash.busy());
+  for (byte verify = 0; verify < 2; verify++) {
+    if (verify)
+      for (long addr = COPY + COPY_SIZE; addr < COPY + 2 * COPY_SIZE; addr += 0x10000)
+        timeErase(64, addr, polls);
+    start = micros();
+    boolean ok = flash.copyRange(COPY, COPY + COPY_SIZE, COPY_SIZE, verify);
+    while (flash.busy());
+    report (verify ? "copy_verify" : "copy", COPY_SIZE, 1, micros() - start);
+    if (!ok) Serial.println ("# Copy verify error");
+  }
+
+  /* Read latency during a 64K erase of the copy region, erase suspend off then on */
+  for (byte suspend = 0; suspend < 2; suspend++) {
+    unsigned long count = 0, total = 0, worst = 0;
+    flash.setEraseSuspend(suspend);
+    start = micros();
+    flash.blockErase64K(COPY);
+    while (flash.busy()) {
+      unsigned long t = micros();
+      flash.readByte(SCRATCH + count);
+      t = micros() - t;
+      total += t;
+      if (t > worst) worst = t;
+      count++;
+      delay (1);
+    }
+    us = micros() - start;
+    flash.setEraseSuspend(false);
+    report (suspend ? "read_erase_suspend" : "read_erase_wait", 1, count, total);
+    report (suspend ? "read_erase_suspend_worst" : "read_erase_wait_worst", 1, 1, worst);
+    report (suspend ? "erase64K_suspended" : "erase64K_reads", 0, 1, us);
+  }
+
+#ifdef SPIFLASHA_STATS
+  flash.printStats();
+  flash.resetStats();
+#endif
+#ifdef SPIFLASHA_HISTOGRAM
+  flash.printHistograms();
+  flash.resetHistograms();
+#endif
+  delay (10000);
+}
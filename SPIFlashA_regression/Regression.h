@@ -0,0 +1,187 @@
+/* SPIFlashA bus cost baseline, shared by SPIFlashA_regression.ino (measured on the board with SPIFlashStats) and by
+ * extras/host (measured on the simulated chip before any board is involved).
+ * Every public call is run once on an idle chip and the bus bytes and selects it costs are compared with the baseline:
+ * a readBytes() of N bytes must stay within N+7 bus bytes (RDSR poll: 2, READ with address and dummy byte: 5).
+ * The calls that wait for the chip themselves (blockErase32K(), blockErase512K(), a read suspending an erase) are
+ * compared without their status polls, whose number depends on the chip timing.
+ * NOTE:  the 512 KBytes at ERASE512K (SCRATCH and HEALTH included) are erased and written
+ *        a change that lowers a cost should lower its baseline too
+*/
+#ifndef _REGRESSION_H_
+#define _REGRESSION_H_
+
+#include <SPIFlashA.h>
+#include <SPIFlashHealth.h>
+#define FLASH_SS      5     // IMPORTANT: on Anarduino miniWireless the Flash SPI salve select is D5 (vs D8 on Moteino)
+#define SCRATCH       0xFF0000
+#define HEALTH        0xFEE000
+#define ERASE512K     0xF80000
+
+#define CALL_READSTATUS    0
+#define CALL_BUSY          1
+#define CALL_READDEVICEID  2
+#define CALL_READUNIQUEID  3
+#define CALL_READBYTE      4
+#define CALL_READBYTES     5
+#define CALL_WRITEBYTE     6
+#define CALL_WRITEBYTES    7
+#define CALL_ERASE4K       8
+#define CALL_ERASE64K      9
+#define CALL_READTO       10
+#define CALL_WRITEFROM    11
+#define CALL_READMANY     12
+#define CALL_FILLBYTES    13
+#define CALL_FILLERASED   14
+#define CALL_READSTATUSALL 15
+#define CALL_COPYRANGE    16
+#define CALL_COMPAREBYTES 17
+#define CALL_STEP         18
+#define CALL_INITIALIZE   19
+#define CALL_WAITREADY    20
+#define CALL_ERASE32K     21
+#define CALL_ERASE512K    22
+#define CALL_SUSPENDREAD  23
+#define CALL_READTOSHARED 24
+
+/* Baseline: a call of size data bytes may cost up to busBytes + perByte * size bus bytes and selects selects,
+ * status polls excluded when noPolls is set */
+struct Baseline {
+  const char* name;
+  byte call;
+  word size;
+  word busBytes;
+  byte perByte;
+  byte selects;
+  boolean noPolls;
+};
+
+const Baseline baseline[] = {
+  { "initialize",    CALL_INITIALIZE,   0,  13,  0, 6 },    // busy(), readDeviceId() and WRR
+  { "readStatus",    CALL_READSTATUS,   0,   2,  0, 1 },
+  { "readStatusAll", CALL_READSTATUSALL, 0,  6,  0, 3 },    // readRegister() of SR1, SR2 and CR
+  { "busy",          CALL_BUSY,         0,   2,  0, 1 },
+  { "waitReady",     CALL_WAITREADY,    0,   2,  0, 1 },
+  { "readDeviceId",  CALL_READDEVICEID, 0,   4,  0, 1 },
+  { "readUniqueId",  CALL_READUNIQUEID, 0,  19,  0, 2 },
+  { "readByte",      CALL_READBYTE,     1,   6,  1, 2 },
+  { "readBytes",     CALL_READBYTES,    1,   7,  1, 2 },
+  { "readBytes",     CALL_READBYTES,  256,   7,  1, 2 },
+  { "readTo",        CALL_READTO,    1024,   7,  1, 2 },
+  { "readTo shared", CALL_READTOSHARED, 1024, 162, 1, 33 }, // 32 chunks, RDSR poll before the first only
+  { "readMany",      CALL_READMANY,    52,   7,  1, 2 },    // 4 reads of 4 bytes 16 bytes apart: one FAST_READ
+  { "writeByte",     CALL_WRITEBYTE,    1,   9,  1, 4 },
+  { "writeBytes",    CALL_WRITEBYTES,   1,   9,  1, 4 },
+  { "writeBytes",    CALL_WRITEBYTES, 256,   9,  1, 4 },
+  { "writeFrom",     CALL_WRITEFROM,  256,   9,  1, 4 },
+  { "fillBytes",     CALL_FILLBYTES,  256,   9,  1, 4 },
+  { "fillBytes 0xFF",CALL_FILLERASED, 256,   0,  0, 0 },
+  { "copyRange",     CALL_COPYRANGE,  256,  16,  2, 6 },    // readBytes() and writeBytes() of the previous page
+  { "compareBytes",  CALL_COMPAREBYTES, 256, 7,  1, 2 },    // verify of copyRange(), alone (there it waits for the program)
+  { "readByte suspend", CALL_SUSPENDREAD, 1, 8, 1, 4, true }, // ERSP, RDSR2, READ and ERRS during a 4K erase
+  { "blockErase4K",  CALL_ERASE4K,      0,   9,  0, 4 },
+  { "blockErase64K", CALL_ERASE64K,     0,   9,  0, 4 },
+  { "step",          CALL_STEP,         0,  13,  0, 6 },    // busy(), blockErase64K() of SCRATCH and busy()
+  { "blockErase32K", CALL_ERASE32K,     0,  40,  0, 16, true }, // 8 * (WREN and P4E)
+  { "blockErase512K",CALL_ERASE512K,    0,  40,  0, 16, true }  // 8 * (WREN and SE)
+};
+
+/* Sink of readTo() discarding the data */
+class NullSink : public SPIFlashSink {
+public:
+  virtual boolean take(const byte* data, byte len) { return true; }
+};
+
+/* Sink of readTo() discarding the data, released between chunks */
+class SharedSink : public NullSink {
+public:
+  virtual boolean sharesBus() { return true; }
+};
+
+/* Source of writeFrom() producing a constant pattern */
+class PatternSource : public SPIFlashSource {
+public:
+  virtual word give(byte* data, word len) { memset(data, 0x5A, len); return len; }
+};
+
+/* SPIFlashA giving access to compareBytes() */
+class RegressionFlash : public SPIFlashA {
+public:
+  RegressionFlash(uint8_t slaveSelectPin, uint32_t jedecID) : SPIFlashA(slaveSelectPin, jedecID) {}
+  using SPIFlashA::compareBytes;
+};
+
+RegressionFlash flash(FLASH_SS, 0x12018);  // Create a SPANION SPI Flash instance
+NullSink sink;
+SharedSink sharedSink;
+PatternSource source;
+byte buffer[256];
+long next = SCRATCH;                 // Next erased location for the writes
+
+/* Set up the chip for a call, outside of the measure */
+void prepare(byte call) {
+  while (flash.busy());              // Measure the call alone, on an idle chip
+  if (call == CALL_SUSPENDREAD) {
+    flash.setEraseSuspend(true);
+    flash.blockErase4K(SCRATCH + 0x8000);
+  }
+}
+
+void run(byte call, word size) {
+  SPIFlashRead requests[4];
+  switch (call) {
+    case CALL_INITIALIZE:   flash.initialize(); break;
+    case CALL_READSTATUS:   flash.readStatus(); break;
+    case CALL_READSTATUSALL: flash.readStatusAll(); break;
+    case CALL_BUSY:         flash.busy(); break;
+    case CALL_WAITREADY:    flash.waitReady(); break;
+    case CALL_READDEVICEID: flash.readDeviceId(); break;
+    case CALL_READUNIQUEID: flash.readUniqueId(); break;
+    case CALL_READBYTE:     flash.readByte(SCRATCH); break;
+    case CALL_READBYTES:    flash.readBytes(SCRATCH, buffer, size); break;
+    case CALL_READTO:       flash.readTo(SCRATCH, size, sink); break;
+    case CALL_READTOSHARED: flash.readTo(SCRATCH, size, sharedSink); break;
+    case CALL_FILLBYTES:    flash.fillBytes(next, size, 0x00); next += 256; break;
+    case CALL_FILLERASED:   flash.fillBytes(next, size, 0xFF); break;
+    case CALL_READMANY:
+      for (byte k = 0; k < 4; k++) {
+        requests[k].addr = SCRATCH + (3 - k) * 16;
+        requests[k].buf = buffer + k * 4;
+        requests[k].len = 4;
+      }
+      flash.readMany(requests, 4);
+      break;
+    case CALL_WRITEBYTE:    flash.writeByte(next, 0x55); next += 256; break;
+    case CALL_WRITEBYTES:   flash.writeBytes(next, buffer, size); next += 256; break;
+    case CALL_WRITEFROM:    flash.writeFrom(next, size, source); next += 256; break;
+    case CALL_ERASE4K:      flash.blockErase4K(SCRATCH); break;
+    case CALL_ERASE64K:     flash.blockErase64K(SCRATCH); break;
+    case CALL_ERASE32K:     flash.blockErase32K(SCRATCH); break;
+    case CALL_ERASE512K:    flash.blockErase512K(ERASE512K); break;
+    case CALL_COPYRANGE:    flash.copyRange(next - 256, next, size); next += 256; break;
+    case CALL_COMPAREBYTES: flash.compareBytes(next - 256, buffer, size); break;
+    case CALL_SUSPENDREAD:
+      flash.readByte(SCRATCH);
+      flash.setEraseSuspend(false);
+      break;
+    case CALL_STEP:
+      flash.beginFullErase(SCRATCH, SCRATCH + 0x10000);
+      flash.step();
+      break;
+  }
+}
+
+/* An erase still running when flush() is called must be in the reloaded erase counters */
+boolean checkHealth() {
+  SPIFlashHealth health(flash, HEALTH);
+  health.begin();
+  uint32_t before = health.eraseCount(SCRATCH);
+  flash.blockErase64K(SCRATCH);
+  health.flush();
+  SPIFlashHealth reloaded(flash, HEALTH);
+  reloaded.begin();
+  uint32_t after = reloaded.eraseCount(SCRATCH);
+  flash.setEraseListener(0);           // Keep the baseline measures free of erase reports
+  return after == before + 16;
+}
+
+#endif
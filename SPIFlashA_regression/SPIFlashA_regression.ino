@@ -0,0 +1,62 @@
+/* SPIFlashA bus cost regression check for Anarduino miniWireless.
+ * The calls of the baseline (Regression.h) are measured with SPIFlashStats, so that a change of SPIFlashA.cpp adding
+ * bus traffic is caught on the board too (extras/host checks the same baseline on a simulated chip).
+ * One CSV line is printed per check (call,size,bus_bytes,limit,selects,limit,result) followed by the number of failures.
+ * The SPIFlashHealth erase counters are then checked to persist an erase still in progress when flush() is called.
+ * NOTE:  uncomment #define SPIFLASHA_STATS in SPIFlashA.h
+ *        the 512 KBytes at ERASE512K (0xF80000) are erased and written by this sketch
+*/
+#include <SPI.h>
+#include <SPIFlashA.h>
+#include <SPIFlashHealth.h>
+#include "Regression.h"
+
+#ifndef SPIFLASHA_STATS
+#error "uncomment #define SPIFLASHA_STATS in SPIFlashA.h"
+#endif
+
+void setup() {
+  Serial.begin (115200);
+  if (flash.initialize())
+    Serial.println("# SPI Flash Init OK!");
+  else
+    Serial.println("# SPI Flash Init FAIL!");
+}
+
+void loop() {
+  SPIFlashStats stats;
+  byte failures = 0;
+
+  flash.blockErase64K(SCRATCH);
+  next = SCRATCH;
+  Serial.println ("call,size,bus_bytes,limit,selects,limit,result");
+  for (byte i = 0; i < sizeof(baseline) / sizeof(baseline[0]); i++) {
+    const Baseline& b = baseline[i];
+    prepare(b.call);
+    flash.resetStats();
+    run(b.call, b.size);
+    flash.readStats(stats);
+    unsigned long busBytes = stats.busBytes;
+    unsigned long selects = stats.selects;
+    if (b.noPolls) {
+      busBytes -= stats.statusBytes;
+      selects -= stats.commands[SPIFlashA::opcodeIndex(SPIFLASH_STATUSREAD)];
+    }
+    unsigned long limit = b.busBytes + (unsigned long) b.perByte * b.size;
+    boolean pass = busBytes <= limit && selects <= b.selects;
+    if (!pass) failures++;
+    Serial.print (b.name); Serial.print (',');
+    Serial.print (b.size); Serial.print (',');
+    Serial.print (busBytes); Serial.print (',');
+    Serial.print (limit); Serial.print (',');
+    Serial.print (selects); Serial.print (',');
+    Serial.print (b.selects); Serial.print (',');
+    Serial.println (pass ? "PASS" : "FAIL");
+  }
+  while (flash.busy());
+  boolean healthPass = checkHealth();
+  if (!healthPass) failures++;
+  Serial.print ("# SPIFlashHealth flush of an erase in progress: "); Serial.println (healthPass ? "PASS" : "FAIL");
+  Serial.print ("# Failures: "); Serial.println (failures);
+  delay (10000);
+}
@@ -0,0 +1,162 @@
+/*
+ * SPIFlashCache: write-back page cache for a SPIFlashA memory (see SPIFlashCache.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <SPIFlashCache.h>
+
+#define COPYCHUNK 32                          // Stack buffer used to move flash content without a page of RAM
+
+SPIFlashCache::SPIFlashCache(SPIFlashA& flash, long scratchSector) : _flash(flash) {
+  _scratch = scratchSector;
+  _clock = 0;
+  _programs = 0;
+  _rewrites = 0;
+  for (byte l = 0; l < SPIFLASHCACHE_LINES; l++) {
+    _page[l] = -1;
+    _age[l] = 0;
+    memset(_dirty[l], 0, sizeof(_dirty[l]));
+  }
+}
+
+/// read len bytes, the cached pages are read from RAM (including not yet written back data)
+void SPIFlashCache::read(long addr, void* buf, word len) {
+  byte* dst = (byte*) buf;
+  while (len > 0) {
+    long page = addr & ~(long)(SPIFLASHCACHE_PAGESIZE - 1);
+    word offset = addr - page;
+    word n = SPIFLASHCACHE_PAGESIZE - offset;
+    if (n > len) n = len;
+    byte l = 0;
+    while (l < SPIFLASHCACHE_LINES && _page[l] != page) l++;
+    if (l < SPIFLASHCACHE_LINES)
+      memcpy(dst, _data[l] + offset, n);
+    else
+      _flash.readBytes(addr, dst, n);
+    dst += n;
+    addr += n;
+    len -= n;
+  }
+}
+
+/// write len bytes into the cache, only the bytes that actually change are marked dirty
+void SPIFlashCache::write(long addr, const void* buf, word len) {
+  const byte* src = (const byte*) buf;
+  while (len > 0) {
+    long page = addr & ~(long)(SPIFLASHCACHE_PAGESIZE - 1);
+    word offset = addr - page;
+    word n = SPIFLASHCACHE_PAGESIZE - offset;
+    if (n > len) n = len;
+    byte l = line(page);
+    for (word i = offset; i < offset + n; i++, src++) {
+      if (_data[l][i] != *src) {
+        _data[l][i] = *src;
+        _dirty[l][i >> 3] |= 1 << (i & 7);
+      }
+    }
+    addr += n;
+    len -= n;
+  }
+}
+
+/// write back all the dirty lines
+void SPIFlashCache::sync() {
+  for (byte l = 0; l < SPIFLASHCACHE_LINES; l++)
+    flush(l);
+}
+
+/// return the line holding page, the least recently used line is written back and reloaded on a miss
+byte SPIFlashCache::line(long page) {
+  byte victim = 0;
+  for (byte l = 0; l < SPIFLASHCACHE_LINES; l++) {
+    if (_page[l] == page) {
+      _age[l] = ++_clock;
+      return l;
+    }
+    if (_page[l] == -1 || (_page[victim] != -1 && _age[l] < _age[victim]))
+      victim = l;
+  }
+  flush(victim);
+  _flash.readBytes(page, _data[victim], SPIFLASHCACHE_PAGESIZE);
+  _page[victim] = page;
+  _age[victim] = ++_clock;
+  return victim;
+}
+
+/// write back line l: one Page Program covering the dirty bytes, or a sector rewrite when a bit must go from 0 to 1
+void SPIFlashCache::flush(byte l) {
+  int first = -1, last = -1;
+  for (int i = 0; i < SPIFLASHCACHE_PAGESIZE; i++) {
+    if (_dirty[l][i >> 3] & (1 << (i & 7))) {
+      if (first < 0) first = i;
+      last = i;
+    }
+  }
+  if (first < 0)
+    return;
+  if (needsErase(l)) {
+    rewriteSector(_page[l] & ~(long)(SPIFLASHCACHE_SECTOR - 1));
+    return;
+  }
+  // The clean bytes inside the span hold the chip content, programming them again leaves them unchanged
+  _flash.writeBytes(_page[l] + first, _data[l] + first, last - first + 1);
+  _programs++;
+  memset(_dirty[l], 0, sizeof(_dirty[l]));
+}
+
+/// check if a dirty byte of line l sets a bit that is 0 in the chip
+boolean SPIFlashCache::needsErase(byte l) {
+  byte chip[COPYCHUNK];
+  for (word base = 0; base < SPIFLASHCACHE_PAGESIZE; base += COPYCHUNK) {
+    if (!(_dirty[l][base >> 3] | _dirty[l][(base >> 3) + 1] | _dirty[l][(base >> 3) + 2] | _dirty[l][(base >> 3) + 3]))
+      continue;						// No dirty byte in this chunk (COPYCHUNK bytes = 4 bitmap bytes)
+    _flash.readBytes(_page[l] + base, chip, COPYCHUNK);
+    for (byte i = 0; i < COPYCHUNK; i++) {
+      word k = base + i;
+      if ((_dirty[l][k >> 3] & (1 << (k & 7))) && (_data[l][k] & ~chip[i]))
+        return true;
+    }
+  }
+  return false;
+}
+
+/// copy len bytes of flash from src to the erased dst, the all 0xFF chunks are not programmed
+static void copyFlash(SPIFlashA& flash, long src, long dst, word len) {
+  byte chunk[COPYCHUNK];
+  for (word i = 0; i < len; i += COPYCHUNK) {
+    flash.readBytes(src + i, chunk, COPYCHUNK);
+    byte all = 0xFF;
+    for (byte k = 0; k < COPYCHUNK; k++)
+      all &= chunk[k];
+    if (all != 0xFF)
+      flash.writeBytes(dst + i, chunk, COPYCHUNK);
+  }
+}
+
+/// erase and restore a 4K sector through the scratch sector, the cached pages of the sector are written from RAM
+void SPIFlashCache::rewriteSector(long sector) {
+  _flash.blockErase4K(_scratch);
+  for (long page = sector; page < sector + SPIFLASHCACHE_SECTOR; page += SPIFLASHCACHE_PAGESIZE) {
+    byte l = 0;
+    while (l < SPIFLASHCACHE_LINES && _page[l] != page) l++;
+    if (l == SPIFLASHCACHE_LINES)
+      copyFlash(_flash, page, _scratch + (page - sector), SPIFLASHCACHE_PAGESIZE);
+  }
+  _flash.blockErase4K(sector);
+  for (long page = sector; page < sector + SPIFLASHCACHE_SECTOR; page += SPIFLASHCACHE_PAGESIZE) {
+    byte l = 0;
+    while (l < SPIFLASHCACHE_LINES && _page[l] != page) l++;
+    if (l == SPIFLASHCACHE_LINES) {
+      copyFlash(_flash, _scratch + (page - sector), page, SPIFLASHCACHE_PAGESIZE);
+    } else {
+      _flash.writeBytes(page, _data[l], SPIFLASHCACHE_PAGESIZE);
+      _programs++;
+      memset(_dirty[l], 0, sizeof(_dirty[l]));
+    }
+  }
+  _rewrites++;
+}
@@ -0,0 +1,52 @@
+/*
+ * SPIFlashCache: write-back page cache for a SPIFlashA memory.
+ * Small scattered writes (counters, status blocks) are merged in RAM in SPIFLASHCACHE_LINES lines of one 256 bytes page,
+ * each with a bitmap of its modified (dirty) bytes. A line is written back to the chip with a single Page Program
+ * when it is evicted or when sync() is called, instead of one WREN + PP + busy cycle per write.
+ *
+ * NOTES:
+ *		1. A Page Program can only change bits from 1 to 0. When a dirty byte needs a 0 to 1 transition the 4K sector holding
+ *		   the page is rewritten: its content is saved in the scratch sector given to the constructor (reserved to the cache),
+ *		   the sector is erased and restored with the cached pages merged in.
+ *		2. The rewrite is not power fail safe: a power loss between the erase and the restore loses the sector content
+ *		3. Data written through the cache is only persistent after sync() (or eviction)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPIFLASHCACHE_H_
+#define _SPIFLASHCACHE_H_
+
+#include <SPIFlashA.h>
+
+#define SPIFLASHCACHE_LINES     2             // Number of cached pages (each takes 256+32+8 bytes of RAM)
+#define SPIFLASHCACHE_PAGESIZE  256
+#define SPIFLASHCACHE_SECTOR    4096          // Smallest erasable unit (P4E)
+
+class SPIFlashCache {
+public:
+  SPIFlashCache(SPIFlashA& flash, long scratchSector);
+  void read(long addr, void* buf, word len);
+  void write(long addr, const void* buf, word len);
+  void sync();
+  unsigned long programs() { return _programs; }
+  unsigned long rewrites() { return _rewrites; }
+protected:
+  byte line(long page);
+  void flush(byte l);
+  boolean needsErase(byte l);
+  void rewriteSector(long sector);
+  SPIFlashA& _flash;
+  long _scratch;
+  long _page[SPIFLASHCACHE_LINES];                      // Page address held by each line, -1 when empty
+  unsigned long _age[SPIFLASHCACHE_LINES];
+  unsigned long _clock;
+  unsigned long _programs;                              // Page Programs issued by write back
+  unsigned long _rewrites;                              // Sector rewrites caused by 0 to 1 transitions
+  byte _dirty[SPIFLASHCACHE_LINES][SPIFLASHCACHE_PAGESIZE / 8];
+  byte _data[SPIFLASHCACHE_LINES][SPIFLASHCACHE_PAGESIZE];
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * SPIFlashCounter: persistent monotonic counter stored in a SPIFlashA memory (see SPIFlashCounter.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <SPIFlashCounter.h>
+
+/// address must be 4K aligned, the counter uses address to address+8191
+SPIFlashCounter::SPIFlashCounter(SPIFlashA& flash, long address) : _flash(flash) {
+  _address = address;
+  _active = 0;
+  _base = 0;
+  _bits = 0;
+}
+
+uint32_t SPIFlashCounter::readBase(byte sector) {
+  uint32_t base;
+  _flash.readBytes(_address + (long) sector * SPIFLASHCOUNTER_SECTOR, &base, sizeof(base));
+  return base;
+}
+
+/// erase a sector and start it at base
+void SPIFlashCounter::open(byte sector, uint32_t base) {
+  long addr = _address + (long) sector * SPIFLASHCOUNTER_SECTOR;
+  _flash.blockErase4K(addr);
+  _flash.writeBytes(addr, &base, sizeof(base));
+  _active = sector;
+  _base = base;
+  _bits = 0;
+}
+
+/// erase both sectors and set the counter to value
+void SPIFlashCounter::format(uint32_t value) {
+  _flash.blockErase4K(_address + SPIFLASHCOUNTER_SECTOR);
+  open(0, value);
+}
+
+/// find the active sector (highest base, the other one may not be erased yet after a power loss) and count its cleared bits
+void SPIFlashCounter::begin() {
+  uint32_t base0 = readBase(0);
+  uint32_t base1 = readBase(1);
+  if (base0 == 0xFFFFFFFF && base1 == 0xFFFFFFFF) {
+    format();
+    return;
+  }
+  if (base0 == 0xFFFFFFFF || (base1 != 0xFFFFFFFF && base1 > base0)) {
+    _active = 1;
+    _base = base1;
+  } else {
+    _active = 0;
+    _base = base0;
+  }
+  // Bits are cleared in order, so the bytes are 0x00 ... 0x00, one partial byte, 0xFF ... 0xFF: search the first non 0x00 byte
+  long data = _address + (long) _active * SPIFLASHCOUNTER_SECTOR + SPIFLASHCOUNTER_HEADER;
+  word low = 0, high = SPIFLASHCOUNTER_SECTOR - SPIFLASHCOUNTER_HEADER;
+  while (low < high) {
+    word mid = (low + high) / 2;
+    if (_flash.readByte(data + mid) == 0x00)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  _bits = (uint32_t) low * 8;
+  if (low < SPIFLASHCOUNTER_SECTOR - SPIFLASHCOUNTER_HEADER) {
+    byte b = _flash.readByte(data + low);
+    while (!(b & 1)) {
+      b >>= 1;
+      _bits++;
+    }
+  }
+}
+
+/// add one to the counter (single byte program, the other sector is opened when the active one is full) and return the new value
+uint32_t SPIFlashCounter::increment() {
+  if (_bits == SPIFLASHCOUNTER_BITS)
+    open(_active ^ 1, value());
+  long data = _address + (long) _active * SPIFLASHCOUNTER_SECTOR + SPIFLASHCOUNTER_HEADER;
+  _flash.writeByte(data + (_bits >> 3), (byte)(0xFF << ((_bits & 7) + 1)));
+  _bits++;
+  return value();
+}
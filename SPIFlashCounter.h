@@ -0,0 +1,42 @@
+/*
+ * SPIFlashCounter: persistent monotonic counter (boot counter, sequence number, wear counter) without erase per increment.
+ * The counter uses two consecutive 4K sectors used alternately. A sector starts with the value of the counter when it
+ * was opened (base) and each increment clears one more bit of the rest of the sector, so that an increment is a single
+ * byte Page Program (writeByte) and an erase is only needed every 32640 increments, when the other sector is opened.
+ *
+ * NOTES:
+ *		1. begin() must be called once after a reset, it finds the active sector and the number of cleared bits by a binary search
+ *		2. The two sectors must be erased (format()) before first use
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPIFLASHCOUNTER_H_
+#define _SPIFLASHCOUNTER_H_
+
+#include <SPIFlashA.h>
+
+#define SPIFLASHCOUNTER_SECTOR  4096
+#define SPIFLASHCOUNTER_HEADER  16            // Bytes reserved at the beginning of a sector for the base value
+#define SPIFLASHCOUNTER_BITS    ((uint32_t)(SPIFLASHCOUNTER_SECTOR - SPIFLASHCOUNTER_HEADER) * 8)
+
+class SPIFlashCounter {
+public:
+  SPIFlashCounter(SPIFlashA& flash, long address);
+  void format(uint32_t value=0);
+  void begin();
+  uint32_t increment();
+  uint32_t value() { return _base + _bits; }
+protected:
+  uint32_t readBase(byte sector);
+  void open(byte sector, uint32_t base);
+  SPIFlashA& _flash;
+  long _address;
+  byte _active;                                 // Sector in use (0 or 1)
+  uint32_t _base;                               // Value when the active sector was opened
+  uint32_t _bits;                               // Bits cleared in the active sector
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * SPIFlashECC: SPIFlashA with an Error Correcting Code per page (see SPIFlashECC.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <SPIFlashECC.h>
+
+/// For each byte value: bits 0-2 XOR of the indexes of the bits set, bits 3-5 XOR of their complements, bit 6 parity
+static const byte ECCTABLE[256] PROGMEM = {
+  0x00, 0x78, 0x71, 0x09, 0x6A, 0x12, 0x1B, 0x63, 0x63, 0x1B, 0x12, 0x6A, 0x09, 0x71, 0x78, 0x00,
+  0x5C, 0x24, 0x2D, 0x55, 0x36, 0x4E, 0x47, 0x3F, 0x3F, 0x47, 0x4E, 0x36, 0x55, 0x2D, 0x24, 0x5C,
+  0x55, 0x2D, 0x24, 0x5C, 0x3F, 0x47, 0x4E, 0x36, 0x36, 0x4E, 0x47, 0x3F, 0x5C, 0x24, 0x2D, 0x55,
+  0x09, 0x71, 0x78, 0x00, 0x63, 0x1B, 0x12, 0x6A, 0x6A, 0x12, 0x1B, 0x63, 0x00, 0x78, 0x71, 0x09,
+  0x4E, 0x36, 0x3F, 0x47, 0x24, 0x5C, 0x55, 0x2D, 0x2D, 0x55, 0x5C, 0x24, 0x47, 0x3F, 0x36, 0x4E,
+  0x12, 0x6A, 0x63, 0x1B, 0x78, 0x00, 0x09, 0x71, 0x71, 0x09, 0x00, 0x78, 0x1B, 0x63, 0x6A, 0x12,
+  0x1B, 0x63, 0x6A, 0x12, 0x71, 0x09, 0x00, 0x78, 0x78, 0x00, 0x09, 0x71, 0x12, 0x6A, 0x63, 0x1B,
+  0x47, 0x3F, 0x36, 0x4E, 0x2D, 0x55, 0x5C, 0x24, 0x24, 0x5C, 0x55, 0x2D, 0x4E, 0x36, 0x3F, 0x47,
+  0x47, 0x3F, 0x36, 0x4E, 0x2D, 0x55, 0x5C, 0x24, 0x24, 0x5C, 0x55, 0x2D, 0x4E, 0x36, 0x3F, 0x47,
+  0x1B, 0x63, 0x6A, 0x12, 0x71, 0x09, 0x00, 0x78, 0x78, 0x00, 0x09, 0x71, 0x12, 0x6A, 0x63, 0x1B,
+  0x12, 0x6A, 0x63, 0x1B, 0x78, 0x00, 0x09, 0x71, 0x71, 0x09, 0x00, 0x78, 0x1B, 0x63, 0x6A, 0x12,
+  0x4E, 0x36, 0x3F, 0x47, 0x24, 0x5C, 0x55, 0x2D, 0x2D, 0x55, 0x5C, 0x24, 0x47, 0x3F, 0x36, 0x4E,
+  0x09, 0x71, 0x78, 0x00, 0x63, 0x1B, 0x12, 0x6A, 0x6A, 0x12, 0x1B, 0x63, 0x00, 0x78, 0x71, 0x09,
+  0x55, 0x2D, 0x24, 0x5C, 0x3F, 0x47, 0x4E, 0x36, 0x36, 0x4E, 0x47, 0x3F, 0x5C, 0x24, 0x2D, 0x55,
+  0x5C, 0x24, 0x2D, 0x55, 0x36, 0x4E, 0x47, 0x3F, 0x3F, 0x47, 0x4E, 0x36, 0x55, 0x2D, 0x24, 0x5C,
+  0x00, 0x78, 0x71, 0x09, 0x6A, 0x12, 0x1B, 0x63, 0x63, 0x1B, 0x12, 0x6A, 0x09, 0x71, 0x78, 0x00
+};
+
+/// Accumulate one byte of a page: the bit index is offset*8+j, so the XOR of the byte indexes is only needed for odd bytes
+#define ECC_ACCUMULATE(col, row, offset, b) { byte t = pgm_read_byte(&ECCTABLE[b]); col ^= t; if (t & 0x40) row ^= (offset); }
+
+/// Pack the accumulators in 3 bytes: 11 bits of indexes, 11 bits of complemented indexes, 2 unused bits set to 1
+static void pack(byte col, byte row, byte* ecc) {
+  byte rowc = (col & 0x40) ? ~row : row;
+  word p = ((word) row << 3) | (col & 7);
+  word pc = ((word) rowc << 3) | ((col >> 3) & 7);
+  ecc[0] = p;
+  ecc[1] = pc;
+  ecc[2] = 0xC0 | ((p >> 8) & 7) | (((pc >> 8) & 7) << 3);
+}
+
+static byte bitCount(word v) {
+  byte n = 0;
+  for (; v; v &= v - 1)
+    n++;
+  return n;
+}
+
+/// start .. start+size-1 is the protected region (4K aligned)
+SPIFlashECC::SPIFlashECC(byte slaveSelectPin, uint32_t jedecID, long start, long size) : SPIFlashA(slaveSelectPin, jedecID) {
+  _start = start;
+  _size = size;
+  _corrected = 0;
+  _errors = 0;
+}
+
+/// compute the 3 ECC bytes of a 256 bytes page held in RAM
+void SPIFlashECC::encode(const void* page, byte* ecc) {
+  byte col = 0, row = 0;
+  for (word i = 0; i < 256; i++)
+    ECC_ACCUMULATE(col, row, (byte) i, ((const byte*) page)[i]);
+  pack(col, row, ecc);
+}
+
+/// compare the stored and computed ECC: on a single bit data error, bit is the index (byte*8+bit) of the bit to flip,
+/// on an error in the ECC itself bit is 0xFFFF (the data is good)
+byte SPIFlashECC::check(const byte* stored, const byte* computed, word& bit) {
+  word d1 = (stored[0] ^ computed[0]) | ((word)((stored[2] ^ computed[2]) & 7) << 8);
+  word d2 = (stored[1] ^ computed[1]) | ((word)(((stored[2] ^ computed[2]) >> 3) & 7) << 8);
+  bit = 0xFFFF;
+  if ((d1 | d2) == 0)
+    return SPIFLASHECC_OK;
+  if ((d1 ^ d2) == 0x7FF) {
+    bit = d1;
+    return SPIFLASHECC_CORRECTED;
+  }
+  if (bitCount(d1) + bitCount(d2) == 1)
+    return SPIFLASHECC_CORRECTED;
+  return SPIFLASHECC_ERROR;
+}
+
+/// read 1 byte, checked and corrected with its page when it is protected (an uncorrectable error is counted by errors())
+byte SPIFlashECC::readByte(long addr) {
+  byte result;
+  readBytes(addr, &result, 1);
+  return result;
+}
+
+/// read unlimited # of bytes, checking and correcting the protected pages on the fly
+byte SPIFlashECC::readBytes(long addr, void* buf, word len) {
+  byte status = SPIFLASHECC_OK;
+  byte* dst = (byte*) buf;
+  while (len > 0) {
+    long page = addr & ~255L;
+    if (!isProtected(page)) {
+      // Run of unprotected pages up to the next protected one, read by a single FAST_READ
+      long next = page + 256;
+      while (next - addr < len && !isProtected(next))
+        next += 256;
+      word n = next - addr < len ? next - addr : len;
+      SPIFlashA::readBytes(addr, dst, n);
+      dst += n;
+      addr += n;
+      len -= n;
+      continue;
+    }
+    // Group of consecutive protected pages of the same sector
+    byte pages = 1;
+    long last = addr + len - 1;
+    while (pages < SPIFLASHECC_GROUP && page + pages * 256L <= last && isProtected(page + pages * 256L))
+      pages++;
+    word n = pages * 256 - (addr - page);
+    if (n > len) n = len;
+    byte result = readGroup(addr, dst, n, pages);
+    if (result > status) status = result;
+    dst += n;
+    addr += n;
+    len -= n;
+  }
+  return status;
+}
+
+/// read len bytes of up to SPIFLASHECC_GROUP protected pages with their ECC slots, then a single FAST_READ of the pages
+byte SPIFlashECC::readGroup(long addr, byte* buf, word len, byte pages) {
+  byte slots[SPIFLASHECC_GROUP * SPIFLASHECC_SLOTS * SPIFLASHECC_SLOTSIZE];
+  long page = addr & ~255L;
+  byte status = SPIFLASHECC_OK;
+  SPIFlashA::readBytes(slotAddress(page), slots, pages * SPIFLASHECC_SLOTS * SPIFLASHECC_SLOTSIZE);
+  readCommand(SPIFLASH_ARRAYREAD, page, pages * 256L);
+  sendAddress(page);
+  send(0); //"dont care"
+  for (byte p = 0; p < pages; p++, page += 256) {
+    // Requested bytes of this page are from..to-1, the rest of the page is only needed for the check
+    word from = addr > page ? addr - page : 0;
+    word to = addr + len < page + 256 ? addr + len - page : 256;
+    byte* dst = buf + (page + from - addr);
+    byte col = 0, row = 0;
+    word offset = 0;
+    for (; offset < from; offset++) {
+      byte b = transfer(0);
+      ECC_ACCUMULATE(col, row, (byte) offset, b);
+    }
+    for (; offset < to; offset++) {
+      byte b = transfer(0);
+      *dst++ = b;
+      ECC_ACCUMULATE(col, row, (byte) offset, b);
+    }
+    for (; offset < 256; offset++) {
+      byte b = transfer(0);
+      ECC_ACCUMULATE(col, row, (byte) offset, b);
+    }
+    // Last valid slot of the page (slots are used in order)
+    byte* stored = 0;
+    for (byte s = 0; s < SPIFLASHECC_SLOTS; s++) {
+      byte* slot = slots + (p * SPIFLASHECC_SLOTS + s) * SPIFLASHECC_SLOTSIZE;
+      if (slot[3] == 0x00)
+        stored = slot;
+    }
+    if (!stored)
+      continue;
+    byte computed[3];
+    word bit;
+    pack(col, row, computed);
+    byte result = check(stored, computed, bit);
+    if (result == SPIFLASHECC_CORRECTED) {
+      _corrected++;
+      long a = page + (bit >> 3);
+      if (bit != 0xFFFF && a >= addr && a < addr + len)
+        buf[a - addr] ^= 1 << (bit & 7);
+    } else if (result == SPIFLASHECC_ERROR) {
+      _errors++;
+    }
+    if (result > status) status = result;
+  }
+  unselect();
+  return status;
+}
+
+/// compute the ECC of a page from the chip content, streaming it without a page buffer
+void SPIFlashECC::streamECC(long page, byte* ecc) {
+  byte col = 0, row = 0;
+  readCommand(SPIFLASH_ARRAYREAD, page, 256);
+  sendAddress(page);
+  send(0); //"dont care"
+  for (word offset = 0; offset < 256; offset++) {
+    byte b = transfer(0);
+    ECC_ACCUMULATE(col, row, (byte) offset, b);
+  }
+  unselect();
+  pack(col, row, ecc);
+}
+
+/// write 1 byte, a protected page uses one of its ECC slots for it (see writeBytes())
+boolean SPIFlashECC::writeByte(long addr, byte byt) {
+  return writeBytes(addr, &byt, 1);
+}
+
+/// write len bytes (page boundaries are handled) and program the ECC of each protected page written in its next free slot
+/// WARNING: as for SPIFlashA::writeBytes the memory must be erased, returns false if a page has no free ECC slot
+boolean SPIFlashECC::writeBytes(long addr, const void* buf, uint16_t len) {
+  const byte* src = (const byte*) buf;
+  while (len > 0) {
+    long page = addr & ~255L;
+    word n = 256 - (addr - page);
+    if (n > len) n = len;
+    if (!isProtected(page)) {
+      SPIFlashA::writeBytes(addr, src, n);
+    } else {
+      byte slots[SPIFLASHECC_SLOTS * SPIFLASHECC_SLOTSIZE];
+      byte s = 0;
+      SPIFlashA::readBytes(slotAddress(page), slots, sizeof(slots));
+      while (s < SPIFLASHECC_SLOTS && slots[s * SPIFLASHECC_SLOTSIZE + 3] == 0x00)
+        s++;
+      if (s == SPIFLASHECC_SLOTS)
+        return false;
+      SPIFlashA::writeBytes(addr, src, n);
+      byte slot[SPIFLASHECC_SLOTSIZE];
+      streamECC(page, slot);
+      slot[3] = 0x00;
+      SPIFlashA::writeBytes(slotAddress(page) + s * SPIFLASHECC_SLOTSIZE, slot, SPIFLASHECC_SLOTSIZE);
+    }
+    src += n;
+    addr += n;
+    len -= n;
+  }
+  return true;
+}
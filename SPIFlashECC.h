@@ -0,0 +1,61 @@
+/*
+ * SPIFlashECC: SPIFlashA with an optional Error Correcting Code on readBytes() and writeBytes() of a protected region.
+ * Each 256 bytes page of the region has a 22 bits Hamming code (the SmartMedia/NAND ECC: XOR of the indexes of the
+ * bits set to 1 and of their complements) which corrects one bit error and detects two bit errors per page.
+ * The code is computed on the fly in the SPI receive loop with a 256 bytes table (PROGMEM), so that checking a page
+ * does not need a page of RAM and costs a table lookup per byte.
+ *
+ * The last page of each 4K sector of the region is the spare area of the 15 other pages of the sector: 4 slots of
+ * 4 bytes (3 ECC bytes + 1 valid marker) per page, so that a page can be written up to 4 times between erases and the
+ * ECC is erased with its data by blockErase4K() / blockErase64K().
+ *
+ * NOTES:
+ *		1. The spare pages (address & 0xF00 == 0xF00 in the region) must not be used for data
+ *		2. readBytes() returns SPIFLASHECC_OK, SPIFLASHECC_CORRECTED (the data in buf is corrected) or SPIFLASHECC_ERROR
+ *		3. writeBytes() refuses to write a page that has no free ECC slot left (4 writes since the last erase)
+ *		4. Pages written without the ECC layer (no valid slot) are read without check
+ *		5. Reads and writes outside the protected region are passed to SPIFlashA unchanged
+ *		6. readByte() and writeByte() go through readBytes() and writeBytes(). The other reads and writes (readTo(),
+ *		   readMany(), writeFrom(), fillBytes(), copyRange()) and any call through a SPIFlashA& or SPIFlashA* (its
+ *		   methods are not virtual) bypass the ECC: they must not be used on the protected region
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPIFLASHECC_H_
+#define _SPIFLASHECC_H_
+
+#include <SPIFlashA.h>
+
+#define SPIFLASHECC_OK          0
+#define SPIFLASHECC_CORRECTED   1
+#define SPIFLASHECC_ERROR       2
+#define SPIFLASHECC_SLOTS       4             // ECC slots (writes between erases) per page
+#define SPIFLASHECC_SLOTSIZE    4             // 3 ECC bytes + valid marker (0x00)
+#define SPIFLASHECC_GROUP       4             // Pages read with a single FAST_READ after reading their ECC slots
+
+class SPIFlashECC : public SPIFlashA {
+public:
+  SPIFlashECC(byte slaveSelectPin, uint32_t jedecID, long start, long size);
+  byte readByte(long addr);
+  byte readBytes(long addr, void* buf, word len);
+  boolean writeByte(long addr, byte byt);
+  boolean writeBytes(long addr, const void* buf, uint16_t len);
+  unsigned long corrected() { return _corrected; }
+  unsigned long errors() { return _errors; }
+  static void encode(const void* page, byte* ecc);
+  static byte check(const byte* stored, const byte* computed, word& bit);
+protected:
+  boolean isProtected(long page) { return page >= _start && page < _start + _size && (page & 0xF00) != 0xF00; }
+  long slotAddress(long page) { return (page | 0xF00) + ((page >> 8) & 15) * (SPIFLASHECC_SLOTS * SPIFLASHECC_SLOTSIZE); }
+  byte readGroup(long addr, byte* buf, word len, byte pages);
+  void streamECC(long page, byte* ecc);
+  long _start;
+  long _size;
+  unsigned long _corrected;
+  unsigned long _errors;
+};
+
+#endif
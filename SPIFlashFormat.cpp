@@ -0,0 +1,197 @@
+/*
+ * SPIFlashFormat: lazy format of a region of a SPIFlashA memory (see SPIFlashFormat.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <SPIFlashFormat.h>
+
+/// Sink of readTo() stopping at the first programmed byte
+class BlankSink : public SPIFlashSink {
+public:
+  BlankSink() { blank = true; }
+  virtual boolean take(const byte* data, byte len) {
+    for (byte i = 0; i < len; i++)
+      if (data[i] != 0xFF) {
+        blank = false;
+        return false;
+      }
+    return true;
+  }
+  boolean blank;
+};
+
+/// meta (4K aligned) is the metadata area (meta to meta+8191), start .. start+size-1 the region (4K aligned)
+SPIFlashFormat::SPIFlashFormat(SPIFlashA& flash, long meta, long start, long size) : _flash(flash) {
+  _meta = meta;
+  _start = start;
+  _sectors = size / SPIFLASHFORMAT_SECTOR;
+  _active = 0;
+  _generation = 0;
+  _next = 0;
+  _erasing = -1;
+  _ready = -1;
+}
+
+/// generation of a metadata copy, false if the copy holds none (erased or interrupted)
+boolean SPIFlashFormat::readGeneration(byte copy, uint32_t& generation) {
+  uint32_t header[2];
+  _flash.readBytes(copyAddress(copy), header, sizeof(header));
+  generation = header[0];
+  return header[0] != 0xFFFFFFFF && header[1] == ~header[0];
+}
+
+/// erase a metadata copy and start a generation in it, all the sectors are logically empty
+void SPIFlashFormat::open(byte copy, uint32_t generation) {
+  uint32_t header[2] = { generation, ~generation };
+  _flash.blockErase4K(copyAddress(copy));
+  _flash.writeBytes(copyAddress(copy), header, sizeof(header));
+  _active = copy;
+  _generation = generation;
+  _next = 0;
+  _ready = -1;
+}
+
+/// load the current generation (a region never formatted is formatted)
+void SPIFlashFormat::begin() {
+  uint32_t generation[2];
+  boolean valid[2];
+  for (byte copy = 0; copy < 2; copy++)
+    valid[copy] = readGeneration(copy, generation[copy]);
+  _erasing = -1;
+  if (!valid[0] && !valid[1]) {
+    open(0, 0);
+  } else if (!valid[0] || (valid[1] && generation[1] > generation[0])) {
+    _active = 1;
+    _generation = generation[1];
+  } else {
+    _active = 0;
+    _generation = generation[0];
+  }
+  _next = 0;
+  _ready = -1;
+}
+
+/// logically erase the whole region: a new generation in the other metadata copy
+void SPIFlashFormat::format() {
+  settle();
+  open(_active ^ 1, _generation + 1);
+}
+
+boolean SPIFlashFormat::pending(word sector) {
+  return _flash.readByte(bitmapAddress(sector)) & (1 << (sector & 7));
+}
+
+/// clear the bit of an erased sector (a single bit Page Program, the other bits of the byte are written at 1)
+void SPIFlashFormat::erased(word sector) {
+  _flash.writeByte(bitmapAddress(sector), ~(1 << (sector & 7)));
+  _ready = sector;
+}
+
+/// finish the erase started by idle(): command() waits for its end before the bit is cleared
+void SPIFlashFormat::settle() {
+  if (_erasing < 0)
+    return;
+  erased(_erasing);
+  _erasing = -1;
+}
+
+/// true if the sector at base is all 0xFF, read a page at a time to keep the interrupts serviced
+boolean SPIFlashFormat::blank(long base) {
+  BlankSink sink;
+  for (word offset = 0; offset < SPIFLASHFORMAT_SECTOR && sink.blank; offset += 256)
+    _flash.readTo(base + offset, 256, sink);
+  return sink.blank;
+}
+
+/// true if the sector of addr is logically empty (not yet erased in this generation)
+boolean SPIFlashFormat::isErased(long addr) {
+  long sector = (addr - _start) / SPIFLASHFORMAT_SECTOR;
+  if (sector == _ready)
+    return false;
+  if (sector == _erasing)
+    return true;
+  return pending(sector);
+}
+
+/// make the sector of addr writable: erase it now if it is logically empty and not blank
+void SPIFlashFormat::prepare(long addr) {
+  long sector = (addr - _start) / SPIFLASHFORMAT_SECTOR;
+  if (sector == _ready)
+    return;
+  settle();
+  if (!pending(sector)) {
+    _ready = sector;
+    return;
+  }
+  long base = _start + sector * SPIFLASHFORMAT_SECTOR;
+  if (!blank(base))
+    _flash.blockErase4K(base);
+  erased(sector);
+}
+
+/// read unlimited # of bytes, the logically empty sectors read as 0xFF without a flash access
+void SPIFlashFormat::readBytes(long addr, void* buf, word len) {
+  byte* dst = (byte*) buf;
+  while (len > 0) {
+    word n = SPIFLASHFORMAT_SECTOR - (addr - _start) % SPIFLASHFORMAT_SECTOR;
+    if (n > len) n = len;
+    if (isErased(addr))
+      memset(dst, 0xFF, n);
+    else
+      _flash.readBytes(addr, dst, n);
+    dst += n;
+    addr += n;
+    len -= n;
+  }
+}
+
+/// write unlimited # of bytes (page boundaries are handled), the logically empty sectors are erased first
+/// WARNING: as for SPIFlashA::writeBytes the bytes written since the sector was erased can only be cleared
+void SPIFlashFormat::writeBytes(long addr, const void* buf, word len) {
+  const byte* src = (const byte*) buf;
+  while (len > 0) {
+    word n = 256 - (addr & 255);
+    if (n > len) n = len;
+    prepare(addr);
+    _flash.writeBytes(addr, src, n);
+    src += n;
+    addr += n;
+    len -= n;
+  }
+}
+
+/// background work, never waits for the chip: erase the next logically empty sector (a blank one is only marked)
+/// returns false once all the sectors of the region are erased in this generation
+boolean SPIFlashFormat::idle() {
+  if (_flash.busy())
+    return true;
+  settle();
+  while (_next < _sectors) {
+    byte bitmap[SPIFLASHFORMAT_CHUNK];
+    word first = _next & ~7;			// First sector of the bitmap chunk
+    word count = (_sectors - first + 7) / 8;
+    if (count > SPIFLASHFORMAT_CHUNK) count = SPIFLASHFORMAT_CHUNK;
+    _flash.readBytes(bitmapAddress(first), bitmap, count);
+    word end = first + count * 8;
+    if (end > _sectors) end = _sectors;
+    for (word sector = _next; sector < end; sector++) {
+      if (!(bitmap[(sector - first) / 8] & (1 << (sector & 7))))
+        continue;
+      _next = sector + 1;
+      long base = _start + (long) sector * SPIFLASHFORMAT_SECTOR;
+      if (blank(base)) {
+        erased(sector);
+      } else {
+        _flash.blockErase4K(base);
+        _erasing = sector;
+      }
+      return true;
+    }
+    _next = end;
+  }
+  return false;
+}
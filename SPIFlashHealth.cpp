@@ -0,0 +1,160 @@
+/*
+ * SPIFlashHealth: persistent erase statistics of a SPIFlashA memory (see SPIFlashHealth.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <SPIFlashHealth.h>
+
+/// address must be 4K aligned, the statistics use address to address+8191; sectors is the number of 64K sectors tracked
+SPIFlashHealth::SPIFlashHealth(SPIFlashA& flash, long address, word sectors) : _flash(flash) {
+  _address = address;
+  _sectors = sectors;
+  _active = 0;
+  _sequence = 0;
+  _count = 0;
+  _bulk = 0;
+  _dropped = 0;
+}
+
+/// load the most recent copy of the table (or create it) and start recording the erases
+void SPIFlashHealth::begin() {
+  uint32_t sequence[2];
+  for (byte copy = 0; copy < 2; copy++)
+    _flash.readBytes(sectorAddress(copy), &sequence[copy], sizeof(uint32_t));
+  if (sequence[0] == 0xFFFFFFFF && sequence[1] == 0xFFFFFFFF) {
+    _flash.blockErase4K(sectorAddress(0));
+    _active = 0;
+    _sequence = 0;
+    _flash.writeBytes(sectorAddress(0), &_sequence, sizeof(_sequence));
+  } else if (sequence[0] == 0xFFFFFFFF || (sequence[1] != 0xFFFFFFFF && sequence[1] > sequence[0])) {
+    _active = 1;
+    _sequence = sequence[1];
+  } else {
+    _active = 0;
+    _sequence = sequence[0];
+  }
+  _flash.setEraseListener(this);
+}
+
+/// record a completed erase in the RAM table (called by SPIFlashA::busy(), no flash access here)
+void SPIFlashHealth::eraseDone(long addr, long size, unsigned long duration) {
+  unsigned long ms = duration / 1000;
+  if (ms == 0) ms = 1;				// 0 means unknown
+  if (ms > 0xFFFF) ms = 0xFFFF;
+  if (size < 0) {
+    _bulk++;
+    return;
+  }
+  word sector = addr >> 16;
+  if (sector >= _sectors)
+    return;
+  byte i = 0;
+  while (i < _count && _pending[i].sector != sector) i++;
+  if (i == _count) {
+    if (_count == SPIFLASHHEALTH_PENDING) {
+      _dropped++;
+      return;
+    }
+    _pending[i].sector = sector;
+    _pending[i].erases = 0;
+    _pending[i].erase4K = 0;
+    _pending[i].erase64K = 0;
+    _count++;
+  }
+  _pending[i].erases += size / 4096;
+  if (size == 4096)
+    _pending[i].erase4K = ms;
+  else
+    _pending[i].erase64K = ms;
+}
+
+/// write the table when the RAM table is half full, to be called regularly
+void SPIFlashHealth::update() {
+  if (_count >= SPIFLASHHEALTH_PENDING / 2 || _bulk)
+    flush();
+}
+
+/// read count entries from the current table, the erased entries (never written) read as 0
+void SPIFlashHealth::readEntries(word first, SPIFlashSectorHealth* entries, byte count) {
+  _flash.readBytes(sectorAddress(_active) + SPIFLASHHEALTH_HEADER + (long) first * sizeof(SPIFlashSectorHealth), entries, count * sizeof(SPIFlashSectorHealth));
+  for (byte k = 0; k < count; k++) {
+    if (entries[k].erases == 0xFFFFFFFF) entries[k].erases = 0;
+    if (entries[k].erase4K == 0xFFFF) entries[k].erase4K = 0;
+    if (entries[k].erase64K == 0xFFFF) entries[k].erase64K = 0;
+  }
+}
+
+/// add the pending erases to the n entries starting at sector first
+void SPIFlashHealth::merge(const Pending* pending, byte count, word bulk, word first, SPIFlashSectorHealth* entries, byte n) {
+  for (byte k = 0; k < n; k++) {
+    entries[k].erases += (uint32_t) bulk * 16;
+    for (byte i = 0; i < count; i++) {
+      if (pending[i].sector != first + k)
+        continue;
+      entries[k].erases += pending[i].erases;
+      if (pending[i].erase4K) entries[k].erase4K = pending[i].erase4K;
+      if (pending[i].erase64K) entries[k].erase64K = pending[i].erase64K;
+    }
+  }
+}
+
+/// write a new copy of the table with the pending erases, the sequence number is written last so that an interrupted
+/// flush leaves the previous copy in use. An erase still in progress is waited for, so that it is written too
+void SPIFlashHealth::flush() {
+  while (_flash.busy());
+  if (_count == 0 && _bulk == 0)
+    return;
+  // Take the pending erases: the erase of the other copy below is itself recorded in the cleared RAM table
+  Pending pending[SPIFLASHHEALTH_PENDING];
+  byte count = _count;
+  word bulk = _bulk;
+  memcpy(pending, _pending, sizeof(pending));
+  _count = 0;
+  _bulk = 0;
+  byte next = _active ^ 1;
+  _flash.blockErase4K(sectorAddress(next));
+  for (word first = 0; first < _sectors; first += SPIFLASHHEALTH_CHUNK) {
+    SPIFlashSectorHealth entries[SPIFLASHHEALTH_CHUNK];
+    byte n = _sectors - first < SPIFLASHHEALTH_CHUNK ? _sectors - first : SPIFLASHHEALTH_CHUNK;
+    readEntries(first, entries, n);
+    merge(pending, count, bulk, first, entries, n);
+    _flash.writeBytes(sectorAddress(next) + SPIFLASHHEALTH_HEADER + (long) first * sizeof(SPIFlashSectorHealth), entries, n * sizeof(SPIFlashSectorHealth));
+  }
+  _sequence++;
+  _flash.writeBytes(sectorAddress(next), &_sequence, sizeof(_sequence));
+  _active = next;
+}
+
+/// statistics of a 64K sector, including the erases not yet written
+void SPIFlashHealth::read(word sector, SPIFlashSectorHealth& health) {
+  readEntries(sector, &health, 1);
+  merge(_pending, _count, _bulk, sector, &health, 1);
+}
+
+/// number of erases (4K units) of the 64K sector holding addr
+uint32_t SPIFlashHealth::eraseCount(long addr) {
+  SPIFlashSectorHealth health;
+  read(addr >> 16, health);
+  return health.erases;
+}
+
+/// address of the 64K sector of from .. to-1 with the fewest erases, the fastest last erase breaks the ties
+long SPIFlashHealth::leastWorn(long from, long to) {
+  long best = -1;
+  SPIFlashSectorHealth bestHealth = { 0, 0, 0 };
+  for (long addr = from & ~0xFFFFL; addr < to; addr += 0x10000) {
+    SPIFlashSectorHealth health;
+    read(addr >> 16, health);
+    word time = health.erase64K ? health.erase64K : health.erase4K * 16;
+    word bestTime = bestHealth.erase64K ? bestHealth.erase64K : bestHealth.erase4K * 16;
+    if (best < 0 || health.erases < bestHealth.erases || (health.erases == bestHealth.erases && time < bestTime)) {
+      best = addr;
+      bestHealth = health;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,72 @@
+/*
+ * SPIFlashHealth: persistent erase counters and erase durations of the 64K sectors of a SPIFlashA memory.
+ * Once begin() is called every blockErase4K() / blockErase64K() / bulkErase() of the SPIFlashA instance is recorded
+ * (through SPIFlashEraseListener) with its duration, measured from the erase command to the first busy() that sees
+ * the chip ready (an upper bound). The erase duration rises as a sector wears, so together with the erase count it
+ * tells log and FTL layers which sectors to prefer (leastWorn()).
+ *
+ * The statistics are kept in two 4K sectors used alternately: a 64 bytes header (sequence number) followed by one
+ * SPIFlashSectorHealth entry per 64K sector. Erases are accumulated in a small RAM table and written as a new copy of
+ * the table by update() (when the RAM table is getting full) or flush().
+ *
+ * NOTES:
+ *		1. Erase counts are in 4K erase units: a 64K erase of a sector counts 16
+ *		2. Call update() regularly (e.g. in loop()) and flush() before a planned power down, pending erases are lost on a reset
+ *		3. The time the chip stays idle between the end of an erase and that busy() is counted in the duration: the
+ *		   durations are accurate when the next command (or a busy() loop) follows the erase closely
+ *		4. The statistics region takes 8 KBytes (4K aligned) and covers up to 504 sectors of 64K (31.5 MBytes)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPIFLASHHEALTH_H_
+#define _SPIFLASHHEALTH_H_
+
+#include <SPIFlashA.h>
+
+#define SPIFLASHHEALTH_SECTOR   4096
+#define SPIFLASHHEALTH_HEADER   64            // Sequence number, the entries start page aligned chunks
+#define SPIFLASHHEALTH_PENDING  12            // 64K sectors with erases not yet written (a chipErase() needs 8)
+#define SPIFLASHHEALTH_CHUNK    8             // Entries copied per Page Program when the table is written
+
+struct SPIFlashSectorHealth {
+  uint32_t erases;                              // Erases in 4K erase units
+  uint16_t erase4K;                             // Duration of the last 4K erase (ms), 0 if unknown
+  uint16_t erase64K;                            // Duration of the last 64K erase (ms), 0 if unknown
+};
+
+class SPIFlashHealth : public SPIFlashEraseListener {
+public:
+  SPIFlashHealth(SPIFlashA& flash, long address, word sectors=256);
+  void begin();
+  void update();
+  void flush();
+  void read(word sector, SPIFlashSectorHealth& health);
+  uint32_t eraseCount(long addr);
+  long leastWorn(long from, long to);
+  unsigned long dropped() { return _dropped; }
+  virtual void eraseDone(long addr, long size, unsigned long duration);
+protected:
+  struct Pending {
+    word sector;
+    word erases;
+    word erase4K;
+    word erase64K;
+  };
+  long sectorAddress(byte copy) { return _address + (long) copy * SPIFLASHHEALTH_SECTOR; }
+  void readEntries(word first, SPIFlashSectorHealth* entries, byte count);
+  void merge(const Pending* pending, byte count, word bulk, word first, SPIFlashSectorHealth* entries, byte n);
+  SPIFlashA& _flash;
+  long _address;
+  word _sectors;
+  byte _active;                                 // Copy (0 or 1) holding the current table
+  uint32_t _sequence;
+  Pending _pending[SPIFLASHHEALTH_PENDING];
+  byte _count;
+  word _bulk;                                   // bulkErase() not yet written
+  unsigned long _dropped;                       // Erases lost because the RAM table was full
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * SPIFlashQueue: persistent FIFO stored in a SPIFlashA memory (see SPIFlashQueue.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <SPIFlashQueue.h>
+
+/// base must be 4K aligned, sectors >= 2
+SPIFlashQueue::SPIFlashQueue(SPIFlashA& flash, long base, word sectors, byte recordSize) : _flash(flash) {
+  _base = base;
+  _sectors = sectors;
+  _slotSize = 2;
+  while (_slotSize < (word) recordSize + 1)
+    _slotSize <<= 1;
+  _slots = (SPIFLASHQUEUE_SECTOR - SPIFLASHQUEUE_PAGESIZE) / _slotSize;
+  _headSector = _tailSector = 0;
+  _headSlot = _tailSlot = 0;
+  _sequence = 0;
+}
+
+/// erase the whole queue region and start empty
+void SPIFlashQueue::format() {
+  for (word s = 0; s < _sectors; s++)
+    _flash.blockErase4K(sectorAddress(s));
+  _headSector = _tailSector = 0;
+  _headSlot = _tailSlot = 0;
+  _sequence = 0;
+}
+
+uint32_t SPIFlashQueue::readSequence(word sector) {
+  uint32_t sequence;
+  _flash.readBytes(sectorAddress(sector), &sequence, sizeof(sequence));
+  return sequence;
+}
+
+byte SPIFlashQueue::slotLength(word sector, word slot) {
+  return _flash.readByte(slotAddress(sector, slot) + _slotSize - 1);
+}
+
+/// rebuild head and tail after a reset: the sectors in use are the chain of consecutive sequence numbers ending at the highest one
+void SPIFlashQueue::begin() {
+  boolean found = false;
+  for (word s = 0; s < _sectors; s++) {
+    uint32_t sequence = readSequence(s);
+    if (sequence != 0xFFFFFFFF && (!found || sequence > _sequence)) {
+      found = true;
+      _sequence = sequence;
+      _tailSector = s;
+    }
+  }
+  if (!found) {
+    _headSector = _tailSector = 0;
+    _headSlot = _tailSlot = 0;
+    _sequence = 0;
+    return;
+  }
+  _tailSlot = 0;
+  while (_tailSlot < _slots && slotLength(_tailSector, _tailSlot) != SPIFLASHQUEUE_FREE)
+    _tailSlot++;
+  if (_tailSlot < _slots) {				// Free slot with a partly programmed record (power loss during enqueue): skip it
+    byte chunk[16];
+    byte all = 0xFF;
+    for (word i = 0; i < _slotSize - 1; i += sizeof(chunk)) {
+      word n = _slotSize - 1 - i;
+      if (n > sizeof(chunk)) n = sizeof(chunk);
+      _flash.readBytes(slotAddress(_tailSector, _tailSlot) + i, chunk, n);
+      for (byte k = 0; k < n; k++)
+        all &= chunk[k];
+    }
+    if (all != 0xFF) {
+      _flash.writeByte(slotAddress(_tailSector, _tailSlot) + _slotSize - 1, SPIFLASHQUEUE_SKIP);
+      _tailSlot++;
+    }
+  }
+  _headSector = _tailSector;
+  word sector = _tailSector;
+  uint32_t sequence = _sequence;
+  for (word n = 1; n < _sectors; n++) {
+    sector = sector ? sector - 1 : _sectors - 1;
+    if (readSequence(sector) != --sequence)
+      break;
+    _headSector = sector;
+  }
+  // Head slot = number of cleared bits of the consumed bitmap of the head sector (bits are cleared in order)
+  _headSlot = 0;
+  long bitmap = sectorAddress(_headSector) + sizeof(_sequence);
+  byte b;
+  while (_headSlot < _slots && (b = _flash.readByte(bitmap + (_headSlot >> 3))) != 0xFF) {
+    byte cleared = 0;
+    while (cleared < 8 && !(b & (1 << cleared)))
+      cleared++;
+    _headSlot += cleared;
+    if (cleared < 8)
+      break;
+  }
+  if (_headSlot > _slots)
+    _headSlot = _slots;
+  if (_headSlot == _slots)
+    recycle();                 // Power loss between the last pop and the erase of the sector
+}
+
+/// append a record of len bytes (1 to record size), return false when the queue is full
+boolean SPIFlashQueue::enqueue(const void* buf, byte len) {
+  if (len == SPIFLASHQUEUE_SKIP || len == SPIFLASHQUEUE_FREE || len > _slotSize - 1)
+    return false;
+  if (_tailSlot == _slots) {
+    word next = (_tailSector + 1) % _sectors;
+    if (next == _headSector)
+      return false;
+    _tailSector = next;
+    _tailSlot = 0;
+  }
+  if (_tailSlot == 0) {						// Open the sector
+    if (readSequence(_tailSector) != 0xFFFFFFFF)
+      _flash.blockErase4K(sectorAddress(_tailSector));
+    _sequence++;
+    _flash.writeBytes(sectorAddress(_tailSector), &_sequence, sizeof(_sequence));
+  }
+  long addr = slotAddress(_tailSector, _tailSlot);
+  _flash.writeBytes(addr, buf, len);
+  _flash.writeByte(addr + _slotSize - 1, len);  // Commit
+  _tailSlot++;
+  return true;
+}
+
+/// copy the oldest record to buf without consuming it, return its length (0 when empty)
+byte SPIFlashQueue::peek(void* buf) {
+  while (size() > 0) {
+    byte len = slotLength(_headSector, _headSlot);
+    if (len != SPIFLASHQUEUE_SKIP) {
+      _flash.readBytes(slotAddress(_headSector, _headSlot), buf, len);
+      return len;
+    }
+    pop();
+  }
+  return 0;
+}
+
+/// consume the oldest record: a single byte program of the consumed bitmap
+void SPIFlashQueue::pop() {
+  if (size() == 0)
+    return;
+  long bitmap = sectorAddress(_headSector) + sizeof(_sequence);
+  _flash.writeByte(bitmap + (_headSlot >> 3), (byte)(0xFF << ((_headSlot & 7) + 1)));
+  _headSlot++;
+  if (_headSlot == _slots)
+    recycle();
+}
+
+/// copy and consume the oldest record, return its length (0 when empty)
+byte SPIFlashQueue::dequeue(void* buf) {
+  byte len = peek(buf);
+  if (len)
+    pop();
+  return len;
+}
+
+/// erase the fully consumed head sector and move the head to the next one
+void SPIFlashQueue::recycle() {
+  _flash.blockErase4K(sectorAddress(_headSector));
+  if (_tailSector == _headSector) {
+    _tailSector = (_tailSector + 1) % _sectors;
+    _tailSlot = 0;
+  }
+  _headSector = (_headSector + 1) % _sectors;
+  _headSlot = 0;
+}
+
+/// number of records in the queue
+long SPIFlashQueue::size() {
+  long sectors = (_tailSector + _sectors - _headSector) % _sectors;
+  return sectors * _slots + _tailSlot - _headSlot;
+}
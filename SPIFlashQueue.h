@@ -0,0 +1,63 @@
+/*
+ * SPIFlashQueue: persistent FIFO of variable length records (typically RFM69 packets) stored in a SPIFlashA memory.
+ * Intended for store and forward: records are enqueued when the gateway is unreachable and dequeued when it is back,
+ * without losing the backlog on reset or power loss.
+ *
+ * The queue uses a circular region of 4K sectors. Each sector holds:
+ *		- page 0: a 4 bytes sequence number written when the sector is opened, followed by the consumed bitmap
+ *		- pages 1 to 15: fixed size slots (record size + 1 rounded up to a power of 2), the last byte of a slot is the
+ *		  record length, written after the record itself so that it acts as the commit of the slot
+ *
+ * NOTES:
+ *		1. enqueue() costs two Page Programs, dequeue()/pop() costs a single byte program: the head pointer is persisted by
+ *		   clearing one more bit of the consumed bitmap, no erase is needed per dequeue
+ *		2. A sector is erased (4K erase, non blocking) as soon as all its records are consumed
+ *		3. begin() must be called after a reset to rebuild the head and tail from the sector headers (format() the region first)
+ *		4. Records are 1 to 254 bytes long, a slot whose record was interrupted by a power loss is skipped at begin()
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPIFLASHQUEUE_H_
+#define _SPIFLASHQUEUE_H_
+
+#include <SPIFlashA.h>
+
+#define SPIFLASHQUEUE_SECTOR    4096
+#define SPIFLASHQUEUE_PAGESIZE  256
+#define SPIFLASHQUEUE_SKIP      0             // Length of a slot skipped after an interrupted enqueue
+#define SPIFLASHQUEUE_FREE      0xFF          // Length of a slot not yet written
+
+class SPIFlashQueue {
+public:
+  SPIFlashQueue(SPIFlashA& flash, long base, word sectors, byte recordSize=61);
+  void format();
+  void begin();
+  boolean enqueue(const void* buf, byte len);
+  byte dequeue(void* buf);
+  byte peek(void* buf);
+  void pop();
+  long size();
+  boolean empty() { return size() == 0; }
+  long capacity() { return (long) _sectors * _slots; }
+protected:
+  long slotAddress(word sector, word slot) { return _base + (long) sector * SPIFLASHQUEUE_SECTOR + SPIFLASHQUEUE_PAGESIZE + (long) slot * _slotSize; }
+  long sectorAddress(word sector) { return _base + (long) sector * SPIFLASHQUEUE_SECTOR; }
+  uint32_t readSequence(word sector);
+  byte slotLength(word sector, word slot);
+  void recycle();
+  SPIFlashA& _flash;
+  long _base;
+  word _sectors;
+  word _slotSize;
+  word _slots;                                  // Slots per sector
+  word _headSector;
+  word _headSlot;
+  word _tailSector;
+  word _tailSlot;                               // == _slots when the tail sector is full
+  uint32_t _sequence;                           // Sequence number of the tail sector
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * SPIFlashRing: log written from interrupt handlers to a SPIFlashA memory (see SPIFlashRing.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <SPIFlashRing.h>
+
+/// start .. start+size-1 is the log region (page aligned, erased)
+SPIFlashRing::SPIFlashRing(SPIFlashA& flash, long start, long size) : _flash(flash) {
+  _start = start;
+  _end = start + size;
+  _written = start;
+  _head = 0;
+  _tail = 0;
+  _overflows = 0;
+  _records = 0;
+}
+
+/// append a record to the ring, to be called from an interrupt handler (or with the interrupts disabled)
+/// returns false if the record does not fit (it is dropped)
+boolean SPIFlashRing::put(const void* data, byte len) {
+  word head = _head;
+  if ((word) (head - _tail) + len > SPIFLASHRING_SIZE) {
+    _overflows++;
+    return false;
+  }
+  for (byte i = 0; i < len; i++, head++)
+    _ring[head % SPIFLASHRING_SIZE] = ((const byte*) data)[i];
+  _head = head;					// Publish the record once it is complete
+  _records++;
+  return true;
+}
+
+/// the head as seen from the main program (a 16 bits load is not atomic on AVR)
+word SPIFlashRing::head() {
+  noInterrupts();
+  word head = _head;
+  interrupts();
+  return head;
+}
+
+/// bytes waiting in the ring
+word SPIFlashRing::used() {
+  return head() - _tail;
+}
+
+/// program the bytes of the ring up to the end of the current page (only if they fill it unless partial)
+boolean SPIFlashRing::program(boolean partial) {
+  word n = 256 - (_written & 255);
+  word available = head() - _tail;
+  if (available < n) {
+    if (!partial || !available)
+      return false;
+    n = available;
+  }
+  if (_written + n > _end)
+    return false;
+  _flash.writeBytes(_written, _ring + _tail % SPIFLASHRING_SIZE, n);
+  _written += n;
+  noInterrupts();				// put() reads the tail
+  _tail += n;
+  interrupts();
+  return true;
+}
+
+/// main program side, never waits for the chip: program the next full page of the ring if the chip is ready
+/// returns true if a page was programmed
+boolean SPIFlashRing::drain() {
+  if (_flash.busy())
+    return false;
+  return program(false);
+}
+
+/// program everything waiting in the ring, including the last partial page
+void SPIFlashRing::flush() {
+  while (program(true));
+}
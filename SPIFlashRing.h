@@ -0,0 +1,53 @@
+/*
+ * SPIFlashRing: log written from interrupt handlers. put() (ISR safe, never waits, no SPI access) appends a record to
+ * a RAM ring, drain() (called from loop()) programs the ring to a log region of a SPIFlashA memory a full page at a
+ * time, when the chip is ready, so that each Page Program carries 256 bytes whatever the record size.
+ *
+ * The ring is single producer (the interrupt handlers, or put() with the interrupts disabled) single consumer (drain()):
+ * the producer only writes the head and the consumer only writes the tail. The ring size is a multiple of the page
+ * size and the log region is page aligned, so that a page of the log is always contiguous in the ring.
+ *
+ * NOTES:
+ *		1. The log region must be erased before use (the ring does not erase), drain() stops at its end
+ *		2. A record that does not fit in the free space of the ring is dropped whole and counted by overflows()
+ *		3. The interrupt handlers are held off during each flash transaction (about 0.6 ms for a page program at 4 MHz
+ *		   SPI): a timer faster than that loses ticks, whatever the ring size
+ *		4. flush() also programs the last partial page, drain() completes that page later
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPIFLASHRING_H_
+#define _SPIFLASHRING_H_
+
+#include <SPIFlashA.h>
+
+#define SPIFLASHRING_SIZE       512           // RAM ring (multiple of 256)
+
+class SPIFlashRing {
+public:
+  SPIFlashRing(SPIFlashA& flash, long start, long size);
+  boolean put(const void* data, byte len);
+  boolean drain();
+  void flush();
+  long written() { return _written; }
+  word used();
+  unsigned long overflows() { return _overflows; }
+  unsigned long records() { return _records; }
+protected:
+  word head();
+  boolean program(boolean partial);
+  SPIFlashA& _flash;
+  long _start;
+  long _end;
+  long _written;                                // Next log address to program
+  byte _ring[SPIFLASHRING_SIZE];
+  volatile word _head;                          // Bytes put (modulo 65536), written by put() only
+  volatile word _tail;                          // Bytes programmed (modulo 65536), written by drain() only
+  volatile unsigned long _overflows;            // Records dropped because the ring was full
+  volatile unsigned long _records;              // Records put
+};
+
+#endif
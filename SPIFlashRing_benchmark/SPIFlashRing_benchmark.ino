@@ -0,0 +1,77 @@
+/* SPIFlashRing sustained throughput benchmark for Anarduino miniWireless.
+ * A Timer1 compare interrupt logs an 8 bytes sample (tick number and micros()) with SPIFlashRing::put() at increasing
+ * rates for 2 seconds each, while loop() drains the ring to the flash. One CSV line per rate:
+ *   rate,ticks,records,overflows,lost_ticks,bytes_per_s
+ * overflows are samples dropped because the ring was full, lost_ticks the ticks missed while the interrupts were
+ * held off by a flash transaction (expected ticks - ticks). The highest rate without either is the safe logging rate.
+ * NOTE:  the 512 KBytes at LOG are erased and rewritten by this sketch
+*/
+#include <SPI.h>
+#include <SPIFlashA.h>
+#include <SPIFlashRing.h>
+#define FLASH_SS      5     // IMPORTANT: on Anarduino miniWireless the Flash SPI salve select is D5 (vs D8 on Moteino)
+#define LOG           0xF80000
+#define LOG_SIZE      0x80000
+#define DURATION      2000  // ms per rate
+
+SPIFlashA flash(FLASH_SS, 0x12018);  // Create a SPANION SPI Flash instance
+SPIFlashRing* ring;
+volatile unsigned long ticks;
+
+ISR(TIMER1_COMPA_vect) {
+  unsigned long sample[2] = { ticks++, micros() };
+  ring->put(sample, sizeof(sample));
+}
+
+/* Timer1 in CTC mode at rate interrupts per second (prescaler 8), 0 stops it */
+void startTimer(unsigned long rate) {
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  TIMSK1 = 0;
+  if (rate) {
+    OCR1A = F_CPU / 8 / rate - 1;
+    TCCR1B = _BV(WGM12) | _BV(CS11);
+    TIMSK1 = _BV(OCIE1A);
+  }
+  interrupts();
+}
+
+void setup() {
+  Serial.begin (115200);
+  if (flash.initialize())
+    Serial.println("# SPI Flash Init OK!");
+  else
+    Serial.println("# SPI Flash Init FAIL!");
+}
+
+void loop() {
+  static const unsigned long rates[] = { 500, 1000, 2000, 4000, 8000, 16000 };
+
+  Serial.println ("rate,ticks,records,overflows,lost_ticks,bytes_per_s");
+  for (byte r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+    for (long addr = LOG; addr < LOG + LOG_SIZE; addr += 0x10000)
+      flash.blockErase64K(addr);
+    while (flash.busy());
+    SPIFlashRing log(flash, LOG, LOG_SIZE);
+    ring = &log;
+    ticks = 0;
+    unsigned long start = millis();
+    startTimer(rates[r]);
+    while (millis() - start < DURATION)
+      log.drain();
+    startTimer(0);
+    unsigned long elapsed = millis() - start;
+    log.flush();
+    while (flash.busy());
+    unsigned long expected = rates[r] * elapsed / 1000;
+    Serial.print (rates[r]); Serial.print (',');
+    Serial.print (ticks); Serial.print (',');
+    Serial.print (log.records()); Serial.print (',');
+    Serial.print (log.overflows()); Serial.print (',');
+    Serial.print (expected > ticks ? expected - ticks : 0); Serial.print (',');
+    Serial.println ((log.written() - LOG) * 1000 / elapsed);
+  }
+  delay (10000);
+}
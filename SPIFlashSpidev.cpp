@@ -0,0 +1,145 @@
+/*
+ * SPIFlashSpidev: SPIFlashTransport over a Linux spidev device (see SPIFlashSpidev.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#ifdef __linux__
+
+#include <SPIFlashSpidev.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+SPIFlashSpidev::SPIFlashSpidev(const char* device, uint32_t speed) {
+  _device = device;
+  _speed = speed;
+  _fd = -1;
+  _count = 0;
+  _bytes = 0;
+  _used = 0;
+  _header = false;
+  _held = false;
+  _messages = 0;
+  _errors = 0;
+}
+
+/// open the device in SPI mode 0, MSB first, 8 bits per word, false if it cannot be opened or set up
+boolean SPIFlashSpidev::open() {
+  byte mode = SPI_MODE_0;
+  byte bits = 8;
+  _fd = ::open(_device, O_RDWR);
+  if (_fd < 0)
+    return false;
+  if (ioctl(_fd, SPI_IOC_WR_MODE, &mode) < 0 || ioctl(_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0
+      || ioctl(_fd, SPI_IOC_WR_MAX_SPEED_HZ, &_speed) < 0) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void SPIFlashSpidev::close() {
+  if (_fd >= 0)
+    ::close(_fd);
+  _fd = -1;
+}
+
+/// start a transaction: nothing is sent before the first message
+void SPIFlashSpidev::select() {
+  _count = 0;
+  _bytes = 0;
+  _used = 0;
+  _header = false;
+}
+
+/// send the queued transfers and release the chip (an empty message when the last one kept it selected)
+void SPIFlashSpidev::unselect() {
+  if (_count == 0 && _held)
+    queue(0, 0, 0);
+  run(false);
+}
+
+/// exchange a byte: it is sent at once with the queued transfers, the chip stays selected
+byte SPIFlashSpidev::transfer(byte b) {
+  send(b);
+  byte i = _used - 1;
+  run(true);
+  return _rx[i];
+}
+
+/// queue a byte in the header buffer, extending the last transfer when it is there
+void SPIFlashSpidev::send(byte b) {
+  if (_used == SPIFLASHSPIDEV_HEADER || _bytes == SPIFLASHSPIDEV_BUFSIZ || (!_header && _count == SPIFLASHSPIDEV_TRANSFERS))
+    run(true);
+  _tx[_used] = b;
+  if (_header) {
+    _transfers[_count - 1].len++;
+    _bytes++;
+  } else {
+    queue(_tx + _used, _rx + _used, 1);
+    _header = true;
+  }
+  _used++;
+}
+
+/// queue len bytes of the caller buffer, which must stay valid until the next message
+void SPIFlashSpidev::send(const byte* buf, word len) {
+  while (len > 0) {
+    word n = len < SPIFLASHSPIDEV_BUFSIZ ? len : SPIFLASHSPIDEV_BUFSIZ;
+    queue(buf, 0, n);
+    buf += n;
+    len -= n;
+  }
+}
+
+/// queue the reception of len bytes straight into buf (0 is sent), filled by the next message
+void SPIFlashSpidev::receive(byte* buf, word len) {
+  while (len > 0) {
+    word n = len < SPIFLASHSPIDEV_BUFSIZ ? len : SPIFLASHSPIDEV_BUFSIZ;
+    queue(0, buf, n);
+    buf += n;
+    len -= n;
+  }
+}
+
+/// append a transfer, sending the queued ones first when the message is full
+void SPIFlashSpidev::queue(const byte* tx, byte* rx, word len) {
+  if (_count == SPIFLASHSPIDEV_TRANSFERS || _bytes + len > SPIFLASHSPIDEV_BUFSIZ)
+    run(true);
+  struct spi_ioc_transfer& t = _transfers[_count++];
+  memset(&t, 0, sizeof(t));
+  t.tx_buf = (unsigned long) tx;
+  t.rx_buf = (unsigned long) rx;
+  t.len = len;
+  t.speed_hz = _speed;
+  t.bits_per_word = 8;
+  _bytes += len;
+  _header = false;
+}
+
+/// send the queued transfers as one message, the chip stays selected after it when keepSelected is set
+void SPIFlashSpidev::run(boolean keepSelected) {
+  if (_count > 0) {
+    _transfers[_count - 1].cs_change = keepSelected;
+    if (!message(_transfers, _count))
+      _errors++;
+    _messages++;
+    _held = keepSelected;
+  }
+  _count = 0;
+  _bytes = 0;
+  _used = 0;
+  _header = false;
+}
+
+/// the SPI_IOC_MESSAGE ioctl of n transfers
+boolean SPIFlashSpidev::message(struct spi_ioc_transfer* transfers, byte n) {
+  return ioctl(_fd, SPI_IOC_MESSAGE(n), transfers) >= 0;
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * SPIFlashSpidev: SPIFlashTransport over a Linux spidev device (/dev/spidevX.Y), to run SPIFlashA on a gateway with the
+ * same S25FL-series chip. The bytes of a transaction are queued as spi_ioc_transfer and sent by a single SPI_IOC_MESSAGE
+ * ioctl when a byte must be read at once (transfer()), when the queue is full or when the chip is released: a readBytes()
+ * or a writeBytes() is one ioctl for its command, address and data, the data going straight from or to the caller buffer.
+ *
+ * NOTES:
+ *		1. Linux only (SPIFLASHA_TRANSPORT is defined there), the Arduino.h and SPI.h of a compatibility layer are still needed
+ *		   by SPIFlashA for micros() and its SPI fallback (extras/host has minimal ones)
+ *		2. The chip select is the one of the spidev device: the slave select pin given to SPIFlashA is not used
+ *		3. A status poll (busy(), waitReady()) costs two ioctls: the one reading the status keeps the chip selected (cs_change
+ *		   of its last transfer) and an empty one releases it
+ *		4. message() is the only call to the device: a test overrides it to run the transfers on a simulated chip
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPIFLASHSPIDEV_H_
+#define _SPIFLASHSPIDEV_H_
+
+#ifdef __linux__
+
+#include <SPIFlashA.h>
+#include <linux/spi/spidev.h>
+
+#define SPIFLASHSPIDEV_SPEED      20000000    // Default SPI clock (Hz)
+#define SPIFLASHSPIDEV_TRANSFERS  8           // spi_ioc_transfer per SPI_IOC_MESSAGE
+#define SPIFLASHSPIDEV_HEADER     32          // Bytes of send() and transfer() queued per message (commands, addresses)
+#define SPIFLASHSPIDEV_BUFSIZ     4096        // Bytes per message (spidev bufsiz module parameter)
+
+class SPIFlashSpidev : public SPIFlashTransport {
+public:
+  SPIFlashSpidev(const char* device, uint32_t speed = SPIFLASHSPIDEV_SPEED);
+  virtual ~SPIFlashSpidev() { close(); }
+  boolean open();
+  void close();
+  virtual void select();
+  virtual void unselect();
+  virtual byte transfer(byte b);
+  virtual void send(byte b);
+  virtual void send(const byte* buf, word len);
+  virtual void receive(byte* buf, word len);
+  virtual void flush() { run(true); }
+  unsigned long messages() { return _messages; }
+  unsigned long errors() { return _errors; }
+protected:
+  virtual boolean message(struct spi_ioc_transfer* transfers, byte n);
+  void queue(const byte* tx, byte* rx, word len);
+  void run(boolean keepSelected);
+  const char* _device;
+  uint32_t _speed;
+  int _fd;
+  struct spi_ioc_transfer _transfers[SPIFLASHSPIDEV_TRANSFERS];
+  byte _count;                                  // Queued transfers
+  word _bytes;                                  // Queued bytes
+  byte _tx[SPIFLASHSPIDEV_HEADER];
+  byte _rx[SPIFLASHSPIDEV_HEADER];
+  byte _used;                                   // Bytes of _tx / _rx queued
+  boolean _header;                              // The last queued transfer is in _tx, send() extends it
+  boolean _held;                                // The chip is still selected after the last message
+  unsigned long _messages;
+  unsigned long _errors;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * SPIFlashTransaction: atomic multi page updates of a SPIFlashA memory (see SPIFlashTransaction.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <SPIFlashTransaction.h>
+
+#define RECORDHEADER 6                        // Log record: 4 bytes destination address, 2 bytes length, data
+
+/// journal must be 4K aligned, sectors >= 3 (header, scratch and at least one log sector)
+SPIFlashTransaction::SPIFlashTransaction(SPIFlashA& flash, long journal, byte sectors) : _flash(flash) {
+  _journal = journal;
+  _logSize = (long)(sectors - 2) * SPIFLASHTX_SECTOR;
+  _logLen = 0;
+  _open = false;
+  _count = 0;
+}
+
+/// to be called at boot: finish a committed transaction interrupted by a power loss, an uncommitted one is ignored
+void SPIFlashTransaction::recover() {
+  if (_flash.readByte(header() + SPIFLASHTX_COMMIT) != 0x00 || _flash.readByte(header() + SPIFLASHTX_DONE) == 0x00)
+    return;
+  _flash.readBytes(header() + SPIFLASHTX_LOGLEN, &_logLen, sizeof(_logLen));
+  scan();
+  apply();
+}
+
+/// start a new transaction, the journal header is erased if a previous transaction used it
+boolean SPIFlashTransaction::begin() {
+  recover();
+  byte chunk[SPIFLASHTX_PROGRESS + SPIFLASHTX_MAXSECTORS];
+  _flash.readBytes(header(), chunk, sizeof(chunk));
+  for (byte i = 0; i < sizeof(chunk); i++) {
+    if (chunk[i] != 0xFF) {
+      _flash.blockErase4K(header());
+      break;
+    }
+  }
+  _logLen = 0;
+  _count = 0;
+  _open = true;
+  return true;
+}
+
+/// log a write of len bytes at addr, return false if the log is full or too many sectors are touched
+boolean SPIFlashTransaction::write(long addr, const void* buf, word len) {
+  if (!_open || _logLen + RECORDHEADER + len > _logSize)
+    return false;
+  for (long sector = addr & ~(long)(SPIFLASHTX_SECTOR - 1); sector < addr + len; sector += SPIFLASHTX_SECTOR)
+    if (!addSector(sector))
+      return false;
+  uint32_t destination = addr;
+  append(&destination, sizeof(destination));
+  append(&len, sizeof(len));
+  append(buf, len);
+  return true;
+}
+
+/// make the transaction durable with a single byte program, then apply it to the destination
+boolean SPIFlashTransaction::commit() {
+  if (!_open)
+    return false;
+  _open = false;
+  _flash.writeBytes(header() + SPIFLASHTX_LOGLEN, &_logLen, sizeof(_logLen));
+  _flash.writeByte(header() + SPIFLASHTX_COMMIT, 0x00);
+  apply();
+  return true;
+}
+
+/// append to the log, page by page, a log sector is erased just before its first byte is written
+void SPIFlashTransaction::append(const void* buf, word len) {
+  const byte* src = (const byte*) buf;
+  while (len > 0) {
+    if ((_logLen & (SPIFLASHTX_SECTOR - 1)) == 0)
+      _flash.blockErase4K(log() + _logLen);
+    word n = 256 - (_logLen & 255);
+    if (n > len) n = len;
+    _flash.writeBytes(log() + _logLen, src, n);
+    _logLen += n;
+    src += n;
+    len -= n;
+  }
+}
+
+boolean SPIFlashTransaction::addSector(long sector) {
+  for (byte i = 0; i < _count; i++)
+    if (_sector[i] == sector)
+      return true;
+  if (_count == SPIFLASHTX_MAXSECTORS)
+    return false;
+  _sector[_count++] = sector;
+  return true;
+}
+
+/// read the header of the log record at offset in a single transaction
+void SPIFlashTransaction::readRecord(uint32_t offset, uint32_t& addr, word& len) {
+  byte record[RECORDHEADER];
+  _flash.readBytes(log() + offset, record, RECORDHEADER);
+  memcpy(&addr, record, sizeof(addr));
+  memcpy(&len, record + sizeof(addr), sizeof(len));
+}
+
+/// rebuild the list of destination sectors from the log
+void SPIFlashTransaction::scan() {
+  _count = 0;
+  for (uint32_t offset = 0; offset < _logLen; ) {
+    uint32_t addr;
+    word len;
+    readRecord(offset, addr, len);
+    for (long sector = addr & ~(long)(SPIFLASHTX_SECTOR - 1); sector < (long) addr + len; sector += SPIFLASHTX_SECTOR)
+      addSector(sector);
+    offset += RECORDHEADER + len;
+  }
+}
+
+/// index the log records writing to a destination sector, in log order and in a single pass over the log. Returns
+/// their number, SPIFLASHTX_RECORDS + 1 if there are too many to index
+byte SPIFlashTransaction::index(long sector, Record* records) {
+  byte count = 0;
+  for (uint32_t offset = 0; offset < _logLen; ) {
+    uint32_t addr;
+    word len;
+    readRecord(offset, addr, len);
+    if ((long) addr < sector + SPIFLASHTX_SECTOR && (long) addr + len > sector) {
+      if (count == SPIFLASHTX_RECORDS)
+        return SPIFLASHTX_RECORDS + 1;
+      records[count].offset = offset;
+      records[count].addr = addr;
+      records[count].len = len;
+      count++;
+    }
+    offset += RECORDHEADER + len;
+  }
+  return count;
+}
+
+/// overwrite the SPIFLASHTX_CHUNK bytes at addr held in buf with the logged writes, in log order: the count records
+/// indexed by index(), or every record of the log when the index overflowed
+void SPIFlashTransaction::merge(long addr, byte* buf, const Record* records, byte count) {
+  if (count <= SPIFLASHTX_RECORDS) {
+    for (byte i = 0; i < count; i++)
+      mergeRecord(records[i].offset, records[i].addr, records[i].len, addr, buf);
+    return;
+  }
+  for (uint32_t offset = 0; offset < _logLen; ) {
+    uint32_t destination;
+    word len;
+    readRecord(offset, destination, len);
+    mergeRecord(offset, destination, len, addr, buf);
+    offset += RECORDHEADER + len;
+  }
+}
+
+/// copy the part of the log record at offset falling in the chunk at addr to buf
+void SPIFlashTransaction::mergeRecord(uint32_t offset, uint32_t destination, word len, long addr, byte* buf) {
+  long start = (long) destination > addr ? (long) destination : addr;
+  long end = (long) destination + len < addr + SPIFLASHTX_CHUNK ? (long) destination + len : addr + SPIFLASHTX_CHUNK;
+  if (start < end)
+    _flash.readBytes(log() + offset + RECORDHEADER + (start - destination), buf + (start - addr), end - start);
+}
+
+/// check if a chunk only holds 0xFF (nothing to program)
+static boolean erased(const byte* buf) {
+  byte all = 0xFF;
+  for (byte k = 0; k < SPIFLASHTX_CHUNK; k++)
+    all &= buf[k];
+  return all == 0xFF;
+}
+
+/// apply every destination sector then mark the transaction done
+void SPIFlashTransaction::apply() {
+  for (byte i = 0; i < _count; i++)
+    applySector(i);
+  _flash.writeByte(header() + SPIFLASHTX_DONE, 0x00);
+}
+
+/// apply the log to one destination sector: in place when only 1 to 0 transitions are needed, otherwise through the scratch
+/// sector. The progress bits make each step restartable after a power loss.
+void SPIFlashTransaction::applySector(byte i) {
+  long sector = _sector[i];
+  long progress = header() + SPIFLASHTX_PROGRESS + i;
+  byte state = _flash.readByte(progress);
+  byte current[SPIFLASHTX_CHUNK];
+  byte merged[SPIFLASHTX_CHUNK];
+  if (!(state & SPIFLASHTX_APPLIED))
+    return;
+  Record records[SPIFLASHTX_RECORDS];
+  byte count = index(sector, records);
+  if (state & SPIFLASHTX_COPIED) {
+    boolean inPlace = true;
+    for (word c = 0; c < SPIFLASHTX_SECTOR && inPlace; c += SPIFLASHTX_CHUNK) {
+      _flash.readBytes(sector + c, current, SPIFLASHTX_CHUNK);
+      memcpy(merged, current, SPIFLASHTX_CHUNK);
+      merge(sector + c, merged, records, count);
+      for (byte k = 0; k < SPIFLASHTX_CHUNK; k++)
+        if (merged[k] & ~current[k])
+          inPlace = false;
+    }
+    if (inPlace) {
+      for (word c = 0; c < SPIFLASHTX_SECTOR; c += SPIFLASHTX_CHUNK) {
+        _flash.readBytes(sector + c, current, SPIFLASHTX_CHUNK);
+        memcpy(merged, current, SPIFLASHTX_CHUNK);
+        merge(sector + c, merged, records, count);
+        if (memcmp(merged, current, SPIFLASHTX_CHUNK))
+          _flash.writeBytes(sector + c, merged, SPIFLASHTX_CHUNK);
+      }
+      _flash.writeByte(progress, state & ~SPIFLASHTX_APPLIED);
+      return;
+    }
+    _flash.blockErase4K(scratch());
+    for (word c = 0; c < SPIFLASHTX_SECTOR; c += SPIFLASHTX_CHUNK) {
+      _flash.readBytes(sector + c, current, SPIFLASHTX_CHUNK);
+      if (!erased(current))
+        _flash.writeBytes(scratch() + c, current, SPIFLASHTX_CHUNK);
+    }
+    state &= ~SPIFLASHTX_COPIED;
+    _flash.writeByte(progress, state);
+  }
+  _flash.blockErase4K(sector);
+  for (word c = 0; c < SPIFLASHTX_SECTOR; c += SPIFLASHTX_CHUNK) {
+    _flash.readBytes(scratch() + c, merged, SPIFLASHTX_CHUNK);
+    merge(sector + c, merged, records, count);
+    if (!erased(merged))
+      _flash.writeBytes(sector + c, merged, SPIFLASHTX_CHUNK);
+  }
+  _flash.writeByte(progress, state & ~SPIFLASHTX_APPLIED);
+}
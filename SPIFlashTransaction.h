@@ -0,0 +1,75 @@
+/*
+ * SPIFlashTransaction: atomic multi page updates of a SPIFlashA memory.
+ * The writes of a transaction are appended to a log (address, length, data) in a journal region and only applied
+ * to their destination once commit() has programmed a single commit byte. After a power loss, recover() (at boot)
+ * rolls a committed transaction forward and forgets a transaction that was not committed, so that the destination
+ * always holds either all or none of the writes.
+ *
+ * The journal region is made of consecutive 4K sectors:
+ *		- sector 0: header (log length, commit byte, done byte, progress bits of each destination sector)
+ *		- sector 1: scratch used to rewrite a destination sector when a bit must go from 0 to 1
+ *		- sectors 2 ...: log
+ *
+ * NOTES:
+ *		1. A destination sector whose new content only clears bits is programmed in place, without any erase
+ *		2. Several updates batched in one transaction share the header and log erases
+ *		3. Reads (readBytes) during a transaction return the content before the transaction
+ *		4. A transaction can touch at most SPIFLASHTX_MAXSECTORS different 4K sectors
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPIFLASHTRANSACTION_H_
+#define _SPIFLASHTRANSACTION_H_
+
+#include <SPIFlashA.h>
+
+#define SPIFLASHTX_SECTOR       4096
+#define SPIFLASHTX_MAXSECTORS   8             // Destination 4K sectors per transaction
+#define SPIFLASHTX_CHUNK        32            // Stack buffer used to merge the log into a destination sector
+#define SPIFLASHTX_RECORDS      16            // Log records indexed per destination sector (more: the log is read per chunk)
+#define SPIFLASHTX_LOGLEN       0             // Header offsets
+#define SPIFLASHTX_COMMIT       4
+#define SPIFLASHTX_DONE         5
+#define SPIFLASHTX_PROGRESS     16
+#define SPIFLASHTX_COPIED       0x01          // Progress bits (cleared when reached)
+#define SPIFLASHTX_APPLIED      0x02
+
+class SPIFlashTransaction {
+public:
+  SPIFlashTransaction(SPIFlashA& flash, long journal, byte sectors=4);
+  void recover();
+  boolean begin();
+  boolean write(long addr, const void* buf, word len);
+  boolean commit();
+  void abort() { _open = false; }
+protected:
+  struct Record {
+    uint32_t offset;                            // Offset of the record in the log
+    uint32_t addr;
+    word len;
+  };
+  long header() { return _journal; }
+  long scratch() { return _journal + SPIFLASHTX_SECTOR; }
+  long log() { return _journal + 2 * SPIFLASHTX_SECTOR; }
+  void append(const void* buf, word len);
+  boolean addSector(long sector);
+  void readRecord(uint32_t offset, uint32_t& addr, word& len);
+  void scan();
+  byte index(long sector, Record* records);
+  void merge(long addr, byte* buf, const Record* records, byte count);
+  void mergeRecord(uint32_t offset, uint32_t destination, word len, long addr, byte* buf);
+  void apply();
+  void applySector(byte i);
+  SPIFlashA& _flash;
+  long _journal;
+  long _logSize;
+  uint32_t _logLen;                             // Bytes appended to the log
+  boolean _open;
+  byte _count;                                  // Destination sectors of the transaction
+  long _sector[SPIFLASHTX_MAXSECTORS];
+};
+
+#endif
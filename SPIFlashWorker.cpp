@@ -0,0 +1,115 @@
+/*
+ * SPIFlashWorker: deferred writes and erases of a SPIFlashA memory (see SPIFlashWorker.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <SPIFlashWorker.h>
+
+SPIFlashWorker::SPIFlashWorker(SPIFlashA& flash) : _flash(flash) {
+  _head = 0;
+  _count = 0;
+  _ticket = 0;
+  _completed = 0;
+  _started = 0;
+  _busy = false;
+  _merged = 0;
+}
+
+/// queue an erase, returns its ticket (0 if the queue is full)
+unsigned long SPIFlashWorker::queue(byte op, long addr) {
+  if (_count == SPIFLASHWORKER_SLOTS)
+    return 0;
+  Slot& s = slot(_count++);
+  s.op = op;
+  s.addr = addr;
+  s.len = 0;
+  s.ticket = ++_ticket;
+  return _ticket;
+}
+
+/// queue a write (copied), returns its ticket (0 if the queue has not enough free slots or len is 0)
+unsigned long SPIFlashWorker::write(long addr, const void* buf, word len) {
+  if (len == 0)
+    return 0;
+  const byte* src = (const byte*) buf;
+  // Room left in the last queued write if this one follows it
+  byte room = 0;
+  if (_count) {
+    Slot& last = slot(_count - 1);
+    if (last.op == SPIFLASHWORKER_WRITE && last.addr + last.len == addr && (addr & 255) != 0)
+      room = SPIFLASHWORKER_DATA - last.len;
+    if (room > 256 - (addr & 255))
+      room = 256 - (addr & 255);
+  }
+  // Slots needed for the rest, split on the pages and the slot size
+  byte needed = 0;
+  long a = addr + (room < len ? room : len);
+  for (long end = addr + len; a < end; needed++) {
+    word n = 256 - (a & 255);
+    if (n > SPIFLASHWORKER_DATA) n = SPIFLASHWORKER_DATA;
+    a += n;
+  }
+  if (needed > SPIFLASHWORKER_SLOTS - _count)
+    return 0;
+  ++_ticket;
+  if (room) {
+    Slot& last = slot(_count - 1);
+    byte n = room < len ? room : len;
+    memcpy(last.data + last.len, src, n);
+    last.len += n;
+    if (n == len)
+      last.ticket = _ticket;
+    _merged++;
+    src += n;
+    addr += n;
+    len -= n;
+  }
+  while (len > 0) {
+    word n = 256 - (addr & 255);
+    if (n > SPIFLASHWORKER_DATA) n = SPIFLASHWORKER_DATA;
+    if (n > len) n = len;
+    Slot& s = slot(_count++);
+    s.op = SPIFLASHWORKER_WRITE;
+    s.addr = addr;
+    s.len = n;
+    s.ticket = n == len ? _ticket : _ticket - 1;	// Only the last slot of the write completes its ticket
+    memcpy(s.data, src, n);
+    src += n;
+    addr += n;
+    len -= n;
+  }
+  return _ticket;
+}
+
+/// start the next queued operation if the chip is ready, never waits
+void SPIFlashWorker::run() {
+  if (_flash.busy())
+    return;
+  if (_busy) {
+    _completed = _started;
+    _busy = false;
+  }
+  if (!_count)
+    return;
+  Slot& s = slot(0);
+  if (s.op == SPIFLASHWORKER_WRITE)
+    _flash.writeBytes(s.addr, s.data, s.len);
+  else if (s.op == SPIFLASHWORKER_ERASE4K)
+    _flash.blockErase4K(s.addr);
+  else
+    _flash.blockErase64K(s.addr);
+  _started = s.ticket;
+  _busy = true;
+  _head = (_head + 1) % SPIFLASHWORKER_SLOTS;
+  _count--;
+}
+
+/// carry out all the queued operations and wait for the last one
+void SPIFlashWorker::flush() {
+  while (_count || _busy)
+    run();
+}
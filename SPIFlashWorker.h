@@ -0,0 +1,65 @@
+/*
+ * SPIFlashWorker: deferred writes and erases of a SPIFlashA memory, so that the application never waits for the chip.
+ * write() and erase4K() / erase64K() copy the operation in a small RAM queue and return a ticket at once, run() (called
+ * from loop()) starts the next queued operation only when the chip is ready and never waits for it. isDone(ticket)
+ * tells when an operation is over (the operations are carried out in order).
+ *
+ * A write following the last queued write (same page, next address) is merged into it, so that a stream of small
+ * records (sensor samples, radio packets) is programmed with one Page Program per slot instead of one per record.
+ *
+ * NOTES:
+ *		1. write() and erase...() return 0 when the queue is full (run() frees the slots), a write needs one slot per page and
+ *		   per SPIFLASHWORKER_DATA bytes it covers. An empty write (len 0) returns 0 as well
+ *		2. The reads are not queued: call flush() (or check isDone()) before reading back data just written
+ *		3. As for SPIFlashA::writeBytes() the memory must be erased, the erases are queued in order with the writes
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _SPIFLASHWORKER_H_
+#define _SPIFLASHWORKER_H_
+
+#include <SPIFlashA.h>
+
+#define SPIFLASHWORKER_SLOTS    4             // Queued operations
+#define SPIFLASHWORKER_DATA     64            // Data bytes per queued write
+#define SPIFLASHWORKER_WRITE    0
+#define SPIFLASHWORKER_ERASE4K  1
+#define SPIFLASHWORKER_ERASE64K 2
+
+class SPIFlashWorker {
+public:
+  SPIFlashWorker(SPIFlashA& flash);
+  unsigned long write(long addr, const void* buf, word len);
+  unsigned long erase4K(long addr) { return queue(SPIFLASHWORKER_ERASE4K, addr); }
+  unsigned long erase64K(long addr) { return queue(SPIFLASHWORKER_ERASE64K, addr); }
+  void run();
+  void flush();
+  boolean isDone(unsigned long ticket) { return (long) (_completed - ticket) >= 0; }
+  byte pending() { return _count; }
+  unsigned long merged() { return _merged; }
+protected:
+  struct Slot {
+    byte op;
+    byte len;
+    long addr;
+    unsigned long ticket;                       // Last ticket complete once this slot is carried out (a write spanning several
+                                                // slots completes its ticket with its last slot only)
+    byte data[SPIFLASHWORKER_DATA];
+  };
+  Slot& slot(byte i) { return _slots[(_head + i) % SPIFLASHWORKER_SLOTS]; }
+  unsigned long queue(byte op, long addr);
+  SPIFlashA& _flash;
+  Slot _slots[SPIFLASHWORKER_SLOTS];
+  byte _head;
+  byte _count;
+  unsigned long _ticket;                        // Last ticket given
+  unsigned long _completed;                     // Last ticket carried out
+  unsigned long _started;                       // Ticket of the operation the chip is busy with
+  boolean _busy;
+  unsigned long _merged;                        // Writes merged into the previous one
+};
+
+#endif
@@ -0,0 +1,70 @@
+/* SPIFlashWorker latency benchmark for Anarduino miniWireless.
+ * Logs bursts of 4 records of 32 bytes every 2 ms, first with direct SPIFlashA::writeBytes() calls (each one waits for the
+ * previous Page Program), then through SPIFlashWorker::write() with run() called between the records, and prints
+ * the average and worst time the application spent in the write call:
+ *   mode,records,avg_us,max_us,merged
+ * NOTE:  the 64 KBytes at SCRATCH are erased and rewritten by this sketch
+*/
+#include <SPI.h>
+#include <SPIFlashA.h>
+#include <SPIFlashWorker.h>
+#define FLASH_SS      5     // IMPORTANT: on Anarduino miniWireless the Flash SPI salve select is D5 (vs D8 on Moteino)
+#define SCRATCH       0xFF0000
+#define RECORDS       512
+#define RECORD_SIZE   32
+#define BURST         4     // Records received back to back
+#define PERIOD        2000  // us between two bursts
+
+SPIFlashA flash(FLASH_SS, 0x12018);  // Create a SPANION SPI Flash instance
+SPIFlashWorker worker(flash);
+byte record[RECORD_SIZE];
+
+void report(const char* mode, unsigned long total, unsigned long worst) {
+  Serial.print (mode); Serial.print (',');
+  Serial.print (RECORDS); Serial.print (',');
+  Serial.print (total / RECORDS); Serial.print (',');
+  Serial.print (worst); Serial.print (',');
+  Serial.println (worker.merged());
+}
+
+void setup() {
+  Serial.begin (115200);
+  if (flash.initialize())
+    Serial.println("# SPI Flash Init OK!");
+  else
+    Serial.println("# SPI Flash Init FAIL!");
+  for (byte i = 0; i < RECORD_SIZE; i++)
+    record[i] = i;
+}
+
+void loop() {
+  unsigned long total, worst, start, next;
+
+  Serial.println ("mode,records,avg_us,max_us,merged");
+  for (byte mode = 0; mode < 2; mode++) {
+    flash.blockErase64K(SCRATCH);
+    while (flash.busy());
+    total = worst = 0;
+    next = micros();
+    for (word i = 0; i < RECORDS; i++) {
+      if (i % BURST == 0) {
+        while ((long) (micros() - next) < 0)
+          if (mode) worker.run();		// Idle time of the application
+        next += PERIOD;
+      }
+      long addr = SCRATCH + (long) i * RECORD_SIZE;
+      start = micros();
+      if (mode)
+        while (!worker.write(addr, record, RECORD_SIZE)) worker.run();
+      else
+        flash.writeBytes(addr, record, RECORD_SIZE);
+      unsigned long duration = micros() - start;
+      total += duration;
+      if (duration > worst) worst = duration;
+    }
+    worker.flush();
+    while (flash.busy());
+    report (mode ? "worker" : "direct", total, worst);
+  }
+  delay (10000);
+}
@@ -0,0 +1,75 @@
+/*
+ * Host stub of the Arduino core: just enough of it to build SPIFlashA and its sketches on a PC (see Makefile).
+ * The time is simulated: micros() only moves when the bus is clocked (HostFlash) or delay() is called.
+ * SPCR and SPSR count their writes so that the host checks can verify that every transaction restores them.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef uint16_t word;
+typedef bool boolean;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define BIN             2
+#define OCT             8
+#define DEC             10
+#define HEX             16
+#define B00000001       1
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+
+/// SPI register: reads as its value, counts its writes
+struct HostRegister {
+  byte value;
+  unsigned long writes;
+  HostRegister& operator=(byte v) { value = v; writes++; return *this; }
+  operator byte() const { return value; }
+};
+
+extern HostRegister SPCR;
+extern HostRegister SPSR;
+extern unsigned long hostMicros;                // Simulated time (us)
+
+inline unsigned long micros() { return hostMicros; }
+inline unsigned long millis() { return hostMicros / 1000; }
+inline void delay(unsigned long ms) { hostMicros += ms * 1000; }
+inline void delayMicroseconds(unsigned int us) { hostMicros += us; }
+inline void noInterrupts() {}
+inline void interrupts() {}
+inline void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t value);  // The chip select of HostFlash
+
+/// Serial output to stdout
+class HostSerial {
+public:
+  void begin(long) {}
+  void print(const char* s) { fputs(s, stdout); }
+  void print(char c) { putchar(c); }
+  void print(long v, int base = DEC);
+  void print(unsigned long v, int base = DEC) { print((long) v, base); }
+  void print(int v, int base = DEC) { print((long) v, base); }
+  void print(unsigned int v, int base = DEC) { print((long) v, base); }
+  void print(byte v, int base = DEC) { print((long) v, base); }
+  void print(double v, int digits = 2) { printf("%.*f", digits, v); }
+  void println() { putchar('\n'); }
+  template <class T> void println(T v) { print(v); println(); }
+  template <class T> void println(T v, int base) { print(v, base); println(); }
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * HostFlash: simulated S25FL127S for the host checks of SPIFlashA (see HostFlash.h)
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <HostFlash.h>
+#include <SPIFlashA.h>
+
+#define OP_NONE         0
+#define OP_PROGRAM      1
+#define OP_ERASE        2                       // P4E or SE: can be suspended
+#define OP_BULKERASE    3
+#define OP_WRITESTATUS  4
+
+HostRegister SPCR;
+HostRegister SPSR;
+unsigned long hostMicros;
+HostSerial Serial;
+SPIClass SPI;
+HostBus hostBus;
+byte hostMemory[HOSTFLASH_SIZE];
+
+static boolean selected;
+static word pos;                                // Bytes clocked since the chip select
+static byte cmd;
+static long addr;
+static boolean wel;
+static byte op;
+static unsigned long busyUntil;                 // End of the operation in progress
+static long eraseAddr;
+static long eraseSize;
+static boolean suspended;
+static unsigned long remaining;                 // Time left of the suspended erase
+
+void HostSerial::print(long v, int base) {
+  if (base == HEX)
+    printf("%lX", v);
+  else if (base == BIN)
+    for (int i = 7; i >= 0; i--) putchar('0' + ((v >> i) & 1));
+  else
+    printf("%ld", v);
+}
+
+void hostReset() {
+  memset(hostMemory, 0xFF, sizeof(hostMemory));
+  selected = false;
+  wel = false;
+  op = OP_NONE;
+  busyUntil = hostMicros;
+  suspended = false;
+  hostClear();
+}
+
+void hostClear() {
+  memset(&hostBus, 0, sizeof(hostBus));
+  SPCR.writes = 0;
+  SPSR.writes = 0;
+}
+
+boolean hostBusy() {
+  return (long) (busyUntil - hostMicros) > 0;
+}
+
+/// start a program or erase of duration us
+static void start(byte operation, unsigned long duration) {
+  op = operation;
+  busyUntil = hostMicros + duration;
+  wel = false;
+}
+
+/// end of a transaction: carry out the command
+static void execute() {
+  if (cmd == SPIFLASH_ERASESUSPEND) {
+    if (hostBusy() && op == OP_ERASE && !suspended) {
+      remaining = busyUntil - hostMicros;
+      busyUntil = hostMicros + 20;			// Suspend latency
+      suspended = true;
+      hostBus.suspends++;
+    }
+    return;
+  }
+  if (cmd == SPIFLASH_ERASERESUME) {
+    if (suspended && !hostBusy()) {
+      busyUntil = hostMicros + remaining;
+      suspended = false;
+    }
+    return;
+  }
+  if (hostBusy())
+    return;
+  if (cmd == SPIFLASH_WRITEENABLE) {
+    wel = true;
+  } else if (cmd == SPIFLASH_WRITEDISABLE) {
+    wel = false;
+  } else if (!wel) {
+    return;
+  } else if (cmd == SPIFLASH_BYTEPAGEPROGRAM && pos > 4) {
+    start(OP_PROGRAM, 300);
+  } else if (suspended) {
+    return;						// No erase while one is suspended
+  } else if ((cmd == SPIFLASH_BLOCKERASE_4K || cmd == SPIFLASH_BLOCKERASE_64K) && pos >= 4) {
+    eraseSize = cmd == SPIFLASH_BLOCKERASE_4K ? 4096 : 65536;
+    eraseAddr = addr & ~(eraseSize - 1);
+    memset(hostMemory + eraseAddr, 0xFF, eraseSize);
+    start(OP_ERASE, cmd == SPIFLASH_BLOCKERASE_4K ? 50000UL : 500000UL);
+  } else if (cmd == SPIFLASH_CHIPERASE) {
+    memset(hostMemory, 0xFF, sizeof(hostMemory));
+    start(OP_BULKERASE, 45000000UL);
+  } else if (cmd == SPIFLASH_STATUSWRITE) {
+    start(OP_WRITESTATUS, 1000);
+  }
+}
+
+void digitalWrite(uint8_t, uint8_t value) {
+  if (value == LOW && !selected) {
+    selected = true;
+    pos = 0;
+    hostBus.selects++;
+  } else if (value == HIGH && selected) {
+    selected = false;
+    if (pos)
+      execute();
+  }
+}
+
+/// data byte of a READ / FAST_READ at offset from the address
+static byte readArray(long offset) {
+  long a = (addr + offset) & (HOSTFLASH_SIZE - 1);
+  if (suspended && a >= eraseAddr && a < eraseAddr + eraseSize)
+    hostBus.suspendViolations++;
+  return hostMemory[a];
+}
+
+byte SPIClass::transfer(byte b) {
+  hostMicros += 2;
+  if (!selected)
+    return 0xFF;
+  hostBus.bytes++;
+  byte out = 0xFF;
+  if (pos == 0) {
+    cmd = b;
+    addr = 0;
+    if (cmd == SPIFLASH_STATUSREAD)
+      hostBus.statusSelects++;
+  } else if (pos <= 3 && cmd != SPIFLASH_STATUSREAD && cmd != SPIFLASH_STATUSREAD2 && cmd != SPIFLASH_CONFIGREAD && cmd != SPIFLASH_IDREAD) {
+    addr = (addr << 8) | b;
+  } else {
+    switch (cmd) {
+      case SPIFLASH_STATUSREAD:   out = (hostBusy() ? 1 : 0) | (wel ? 2 : 0); break;
+      case SPIFLASH_STATUSREAD2:  out = suspended ? 2 : 0; break;
+      case SPIFLASH_CONFIGREAD:   out = 0; break;
+      case SPIFLASH_IDREAD:       out = pos == 1 ? 0x01 : pos == 2 ? 0x20 : pos == 3 ? 0x18 : 0; break;
+      case SPIFLASH_MACREAD:      out = pos > 4 ? 0xA0 + pos : 0; break;
+      case SPIFLASH_ARRAYREADLOWFREQ: out = readArray(pos - 4); break;
+      case SPIFLASH_ARRAYREAD:    if (pos > 4) out = readArray(pos - 5); break;
+      case SPIFLASH_BYTEPAGEPROGRAM:
+        if (wel && !hostBusy())
+          hostMemory[(addr & ~255L) | ((addr + pos - 4) & 255)] &= b;
+        break;
+    }
+  }
+  if (cmd == SPIFLASH_STATUSREAD)
+    hostBus.statusBytes++;
+  pos++;
+  return out;
+}
@@ -0,0 +1,42 @@
+/*
+ * HostFlash: simulated S25FL127S behind the SPI and digitalWrite() stubs, for the host checks of SPIFlashA.
+ * Implements the commands used by the library (READ, FAST_READ, PP, P4E, SE, BE, WREN, WRDI, WRR, RDSR1/2, RDCR, RDID,
+ * OTPR, ERSP, ERRS) with fixed operation times, and counts the bus traffic the way the library should see it.
+ *
+ * NOTES:
+ *		1. Times: 2 us per byte clocked, PP 300 us, P4E 50 ms, SE 500 ms, BE 45 s, WRR 1 ms, ERSP latency 20 us
+ *		2. ERSP suspends a P4E or SE (not a BE); a read of the sector being erased while it is suspended is counted
+ *		   in HostBus::suspendViolations
+ *		3. Any pin is the chip select: the host checks use a single chip
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _HOSTFLASH_H_
+#define _HOSTFLASH_H_
+
+#include <Arduino.h>
+
+#define HOSTFLASH_SIZE      0x1000000
+
+/// Bus traffic seen by the chip
+struct HostBus {
+  unsigned long bytes;                          // Bytes clocked while the chip is selected
+  unsigned long selects;
+  unsigned long statusBytes;                    // Bytes of the RDSR1 transactions (status polls)
+  unsigned long statusSelects;
+  unsigned long suspends;                       // Erases suspended by ERSP
+  unsigned long suspendViolations;              // Reads of a sector while its erase is suspended
+  unsigned long registerWrites() { return SPCR.writes + SPSR.writes; }
+};
+
+extern HostBus hostBus;
+extern byte hostMemory[HOSTFLASH_SIZE];
+
+void hostReset();                               // Erased chip, idle, counters cleared
+void hostClear();                               // Clear the counters only
+boolean hostBusy();                             // WIP: program or erase in progress (not while suspended)
+
+#endif
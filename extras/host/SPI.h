@@ -0,0 +1,31 @@
+/*
+ * Host stub of the Arduino SPI library: transfer() clocks a byte through the simulated chip of HostFlash.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+#ifndef _HOST_SPI_H_
+#define _HOST_SPI_H_
+
+#include <Arduino.h>
+
+#define SPI_MODE0       0x00
+#define MSBFIRST        1
+#define SPI_CLOCK_DIV2  0x04
+#define SPI_CLOCK_DIV4  0x00
+
+class SPIClass {
+public:
+  void begin() {}
+  void end() {}
+  void setDataMode(byte) {}
+  void setBitOrder(byte) {}
+  void setClockDivider(byte) {}
+  byte transfer(byte b);
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * Host check of the SPIFlashA bus cost baseline (SPIFlashA_regression/Regression.h) on the simulated chip: the bus
+ * bytes and selects counted by HostFlash are compared with the baseline, and with the library's own SPIFlashStats.
+ * Every unselect() must also restore SPCR and SPSR exactly once. Returns the number of failures.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <HostFlash.h>
+#include "../../SPIFlashA_regression/Regression.h"
+
+int main() {
+  SPIFlashStats stats;
+  int failures = 0;
+
+  hostReset();
+  flash.initialize();
+  printf("call,size,bus_bytes,limit,selects,limit,stats,registers,result\n");
+  for (byte i = 0; i < sizeof(baseline) / sizeof(baseline[0]); i++) {
+    const Baseline& b = baseline[i];
+    prepare(b.call);
+    hostClear();
+    flash.resetStats();
+    run(b.call, b.size);
+    flash.readStats(stats);
+    unsigned long busBytes = hostBus.bytes;
+    unsigned long selects = hostBus.selects;
+    if (b.noPolls) {
+      busBytes -= hostBus.statusBytes;
+      selects -= hostBus.statusSelects;
+    }
+    unsigned long limit = b.busBytes + (unsigned long) b.perByte * b.size;
+    boolean statsOk = stats.busBytes == hostBus.bytes && stats.selects == hostBus.selects && stats.statusBytes == hostBus.statusBytes;
+    // initialize() starts with an unselect() of its own
+    unsigned long transactions = hostBus.selects + (b.call == CALL_INITIALIZE ? 1 : 0);
+    boolean registersOk = hostBus.registerWrites() == 2 * transactions;
+    boolean pass = busBytes <= limit && selects <= b.selects && statsOk && registersOk;
+    if (!pass) failures++;
+    printf("%s,%u,%lu,%lu,%lu,%u,%s,%s,%s\n", b.name, b.size, busBytes, limit, selects, b.selects,
+      statsOk ? "ok" : "differ", registersOk ? "ok" : "differ", pass ? "PASS" : "FAIL");
+  }
+  while (flash.busy());
+  boolean healthPass = checkHealth();
+  if (!healthPass) failures++;
+  printf("# SPIFlashHealth flush of an erase in progress: %s\n", healthPass ? "PASS" : "FAIL");
+  printf("# Failures: %d\n", failures);
+  return failures;
+}
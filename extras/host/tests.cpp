@@ -0,0 +1,285 @@
+/*
+ * Host tests of SPIFlashA and its companion modules on the simulated chip (HostFlash). Each test prints its name and
+ * PASS or FAIL, main() returns the number of failures.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+*/
+
+#include <HostFlash.h>
+#include <SPIFlashA.h>
+#include <SPIFlashWorker.h>
+#include <SPIFlashECC.h>
+#include <SPIFlashSpidev.h>
+
+#define CHECK(condition) if (!(condition)) { printf("  %s:%d: %s\n", __FILE__, __LINE__, #condition); return false; }
+
+SPIFlashA flash(5, 0x12018);
+
+/// a write spanning several slots is only done once its last slot is programmed
+boolean workerMultiSlotWrite() {
+  SPIFlashWorker worker(flash);
+  byte data[192];
+  for (word i = 0; i < sizeof(data); i++)
+    data[i] = i;
+  unsigned long ticket = worker.write(0x10000, data, sizeof(data));
+  CHECK(ticket != 0);
+  CHECK(worker.pending() == 3);
+  while (worker.pending()) {
+    CHECK(!worker.isDone(ticket));
+    worker.run();
+  }
+  worker.flush();
+  CHECK(worker.isDone(ticket));
+  CHECK(memcmp(hostMemory + 0x10000, data, sizeof(data)) == 0);
+  return true;
+}
+
+/// same when the write starts by filling the last queued slot
+boolean workerMergedMultiSlotWrite() {
+  SPIFlashWorker worker(flash);
+  byte data[150];
+  for (word i = 0; i < sizeof(data); i++)
+    data[i] = ~i;
+  unsigned long first = worker.write(0x20000, data, 10);
+  unsigned long ticket = worker.write(0x2000A, data, sizeof(data));
+  CHECK(worker.merged() == 1);
+  while (worker.pending()) {
+    CHECK(!worker.isDone(ticket));
+    worker.run();
+  }
+  worker.flush();
+  CHECK(worker.isDone(first) && worker.isDone(ticket));
+  CHECK(memcmp(hostMemory + 0x2000A, data, sizeof(data)) == 0);
+  return true;
+}
+
+/// an erase given an address inside its sector suspends for the reads outside that sector only
+boolean eraseSuspendUnaligned() {
+  flash.setEraseSuspend(true);
+  flash.blockErase4K(0x100800);
+  flash.readByte(0x101000);
+  CHECK(hostBus.suspends == 1);
+  flash.readByte(0x100000);
+  CHECK(hostBus.suspends == 1);
+  CHECK(hostBus.suspendViolations == 0);
+  CHECK(!flash.busy());
+  flash.setEraseSuspend(false);
+  return true;
+}
+
+/// latency of a read during a 64K erase, erase suspend off then on
+unsigned long eraseReadLatency(boolean suspend) {
+  flash.setEraseSuspend(suspend);
+  flash.blockErase64K(0x200000);
+  unsigned long start = hostMicros;
+  flash.readByte(0x300000);
+  unsigned long us = hostMicros - start;
+  while (flash.busy());
+  flash.setEraseSuspend(false);
+  return us;
+}
+
+boolean eraseSuspendLatency() {
+  unsigned long wait = eraseReadLatency(false);
+  unsigned long suspended = eraseReadLatency(true);
+  printf("  read during erase: %lu us waiting, %lu us suspending\n", wait, suspended);
+  CHECK(suspended * 100 < wait);
+  CHECK(hostBus.suspendViolations == 0);
+  return true;
+}
+
+/// Sink of readTo() keeping the data
+class CopySink : public SPIFlashSink {
+public:
+  CopySink(boolean shared) { _shared = shared; len = 0; }
+  virtual boolean take(const byte* data, byte n) { memcpy(buf + len, data, n); len += n; return true; }
+  virtual boolean sharesBus() { return _shared; }
+  byte buf[300];
+  word len;
+private:
+  boolean _shared;
+};
+
+/// readTo() gives the same data whether the sink shares the bus or not, also while it suspends an erase
+boolean readToSinks() {
+  for (word i = 0; i < 300; i++)
+    hostMemory[0x30005 + i] = i * 7;
+  for (byte shared = 0; shared < 2; shared++) {
+    CopySink sink(shared);
+    flash.setEraseSuspend(true);
+    flash.blockErase4K(0x40000);
+    CHECK(flash.readTo(0x30005, 300, sink) == 300);
+    CHECK(sink.len == 300);
+    for (word i = 0; i < 300; i++)
+      CHECK(sink.buf[i] == (byte) (i * 7));
+    while (flash.busy());
+    flash.setEraseSuspend(false);
+  }
+  CHECK(hostBus.suspends >= 2);
+  CHECK(hostBus.suspendViolations == 0);
+  return true;
+}
+
+/// unprotected pages are read by a single FAST_READ up to the protected region, which is still checked
+boolean eccUnprotectedRead() {
+  SPIFlashECC ecc(5, 0x12018, 0x51000, 0x1000);
+  static byte data[0x1100];
+  static byte buf[0x1100];
+  for (word i = 0; i < sizeof(data); i++)
+    data[i] = i * 3;
+  memcpy(hostMemory + 0x50000, data, 0x1000);
+  CHECK(ecc.writeBytes(0x51000, data + 0x1000, 0x100));
+  while (ecc.busy());
+  unsigned long selects = hostBus.selects;
+  CHECK(ecc.readBytes(0x50000, buf, 0x1000) == SPIFLASHECC_OK);
+  CHECK(hostBus.selects - selects == 2);
+  CHECK(memcmp(buf, data, 0x1000) == 0);
+  hostMemory[0x51010] ^= 4;
+  CHECK(ecc.readBytes(0x50010, buf, 0x10F0) == SPIFLASHECC_CORRECTED);
+  CHECK(memcmp(buf, data + 0x10, 0x10F0) == 0);
+  return true;
+}
+
+/// spidev whose messages are carried out by the simulated chip
+class FakeSpidev : public SPIFlashSpidev {
+public:
+  FakeSpidev() : SPIFlashSpidev("/dev/null") { _selected = false; }
+protected:
+  virtual boolean message(struct spi_ioc_transfer* transfers, byte n) {
+    if (!_selected)
+      digitalWrite(5, LOW);
+    for (byte t = 0; t < n; t++) {
+      const byte* tx = (const byte*) transfers[t].tx_buf;
+      byte* rx = (byte*) transfers[t].rx_buf;
+      for (word i = 0; i < transfers[t].len; i++) {
+        byte b = SPI.transfer(tx ? tx[i] : 0);
+        if (rx) rx[i] = b;
+      }
+    }
+    _selected = transfers[n - 1].cs_change;
+    if (!_selected)
+      digitalWrite(5, HIGH);
+    return true;
+  }
+  boolean _selected;
+};
+
+/// SPIFlashA through the spidev transport: same data and bus bytes, a FAST_READ is one message
+boolean spidevTransport() {
+  FakeSpidev spidev;
+  SPIFlashA bridged(5, 0x12018);
+  bridged.setTransport(&spidev);
+  CHECK(bridged.initialize());
+  byte data[256], buf[256];
+  for (word i = 0; i < sizeof(data); i++)
+    data[i] = i ^ 0x5A;
+  bridged.blockErase4K(0x60000);
+  bridged.writeBytes(0x60000, data, sizeof(data));
+  while (bridged.busy());
+  hostClear();
+  bridged.resetStats();
+  unsigned long registers = hostBus.registerWrites();
+  unsigned long messages = spidev.messages();
+  bridged.readBytes(0x60000, buf, sizeof(buf));
+  CHECK(spidev.messages() - messages == 3);     // RDSR poll (status, then release) and FAST_READ
+  CHECK(memcmp(buf, data, sizeof(data)) == 0);
+  SPIFlashStats stats;
+  bridged.readStats(stats);
+  CHECK(stats.busBytes == hostBus.bytes && stats.selects == hostBus.selects);
+  CopySink sink(false);
+  CHECK(bridged.readTo(0x60000, 256, sink) == 256);
+  CHECK(memcmp(sink.buf, data, 256) == 0);
+  CHECK(spidev.errors() == 0);
+  CHECK(hostBus.registerWrites() == registers);
+  return true;
+}
+
+/// factor 4 buckets, the last one counting the longer durations, byte counters saturating at 255
+boolean histogramBuckets() {
+  SPIFlashHistogram histogram;
+  memset(&histogram, 0, sizeof(histogram));
+  histogram.add(0);
+  histogram.add(3);
+  histogram.add(4);
+  histogram.add(1048575);
+  histogram.add(100000000);
+  for (word i = 0; i < 300; i++)
+    histogram.add(20);
+  CHECK(sizeof(histogram) == SPIFLASHHISTO_BUCKETS);
+  CHECK(histogram.buckets[0] == 2 && histogram.buckets[1] == 1);
+  CHECK(histogram.buckets[2] == 255);
+  CHECK(histogram.buckets[9] == 1);
+  CHECK(histogram.buckets[SPIFLASHHISTO_BUCKETS - 1] == 1);
+  return true;
+}
+
+/// an unaligned incremental erase only erases the whole 64K sectors inside its range
+boolean fullEraseUnaligned() {
+  memset(hostMemory + 0x70000, 0, 0x40000);
+  flash.beginFullErase(0x70800, 0x9F800);
+  CHECK(flash.erasedTo() == 0x80000);
+  while (flash.step(1000000));
+  CHECK(flash.erasedTo() == 0x90000);
+  CHECK(hostMemory[0x7FFFF] == 0 && hostMemory[0x90000] == 0);
+  for (long a = 0x80000; a < 0x90000; a++)
+    CHECK(hostMemory[a] == 0xFF);
+  flash.beginFullErase(0xA0800, 0xAF800);
+  CHECK(!flash.step());
+  CHECK(hostMemory[0xA0000] == 0 && hostMemory[0xAF7FF] == 0);
+  return true;
+}
+
+/// the polls of a busy() loop after a command are not counted in its trace entry, those of its own wait are
+boolean tracePolls() {
+  byte data[16] = { 0 };
+  flash.clearTrace();
+  flash.writeBytes(0x90000, data, sizeof(data));
+  byte last = flash.traceCount() - 1;
+  word polls = flash.trace(last).polls;
+  CHECK(flash.trace(last).opcode == SPIFLASH_BYTEPAGEPROGRAM && polls >= 1);
+  unsigned long n = 0;
+  while (flash.busy())
+    n++;
+  CHECK(n > 0);
+  CHECK(flash.trace(last).polls == polls);
+  flash.writeBytes(0x90100, data, sizeof(data));
+  flash.readBytes(0x90000, data, sizeof(data));
+  last = flash.traceCount() - 1;
+  CHECK(flash.trace(last).opcode == SPIFLASH_ARRAYREAD && flash.trace(last).polls > 1);
+  return true;
+}
+
+struct Test {
+  const char* name;
+  boolean (*run)();
+};
+
+const Test tests[] = {
+  { "workerMultiSlotWrite", workerMultiSlotWrite },
+  { "workerMergedMultiSlotWrite", workerMergedMultiSlotWrite },
+  { "eraseSuspendUnaligned", eraseSuspendUnaligned },
+  { "eraseSuspendLatency", eraseSuspendLatency },
+  { "readToSinks", readToSinks },
+  { "eccUnprotectedRead", eccUnprotectedRead },
+  { "spidevTransport", spidevTransport },
+  { "histogramBuckets", histogramBuckets },
+  { "fullEraseUnaligned", fullEraseUnaligned },
+  { "tracePolls", tracePolls }
+};
+
+int main() {
+  int failures = 0;
+  for (byte i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    hostReset();
+    flash.initialize();
+    while (flash.busy());
+    boolean pass = tests[i].run();
+    if (!pass) failures++;
+    printf("%s: %s\n", tests[i].name, pass ? "PASS" : "FAIL");
+  }
+  printf("# Failures: %d\n", failures);
+  return failures;
+}